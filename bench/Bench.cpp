@@ -0,0 +1,128 @@
+// Drives a real hypridle through a stand-in compositor and logind and reports how long it takes from an event to the command it runs.
+#include "Harness.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <string>
+
+static const char* USAGE = R"#(Usage: hypridle-bench [options]
+
+Runs hypridle against a stand-in compositor and a fake logind on a private dbus-daemon and reports
+idle -> exec, resume -> exec and sleep inhibitor release latency percentiles.
+
+Options:
+  --hypridle <path>         The hypridle binary to benchmark (default: the one built alongside)
+  -n, --iterations <n>      Idle/resume/sleep cycles to run (default: 200)
+  -v, --verbose             Let hypridle log verbosely
+  -h, --help                Show this help message
+)#";
+
+constexpr auto EVENT_TIMEOUT = std::chrono::seconds(5);
+
+int main(int argc, char** argv) {
+    CBenchHarness::SOptions options = {.hypridle = HYPRIDLE_BENCH_HYPRIDLE};
+    size_t                  iterations = 200;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string ARG = argv[i];
+
+        if (ARG == "--help" || ARG == "-h") {
+            std::cout << USAGE;
+            return 0;
+        } else if (ARG == "--verbose" || ARG == "-v")
+            options.verbose = true;
+        else if ((ARG == "--hypridle") && i + 1 < argc)
+            options.hypridle = argv[++i];
+        else if ((ARG == "--iterations" || ARG == "-n") && i + 1 < argc) {
+            try {
+                iterations = std::max(std::stoul(argv[++i]), 1UL);
+            } catch (...) {
+                std::cerr << "Invalid iteration count " << argv[i] << "\n";
+                return 1;
+            }
+        } else {
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+
+    CBenchHarness harness;
+
+    // the listener timeout doesn't matter, the stand-in compositor sends idled whenever we ask it to
+    const std::string MARK = std::format("{} {}", HYPRIDLE_BENCH_MARK, harness.markSocket());
+    options.config         = std::format(R"#(general {{
+    inhibit_sleep = 1
+}}
+
+listener {{
+    timeout = 1
+    on-timeout = {0} idle
+    on-resume = {0} resume
+}}
+)#",
+                                         MARK);
+
+    const auto STARTED = std::chrono::steady_clock::now();
+    if (!harness.start(options))
+        return 1;
+
+    if (!harness.waitFor([&]() { return harness.idleNotifications() > 0 && harness.sleepInhibitorsHeld() > 0; }, std::chrono::seconds(10))) {
+        std::cerr << "hypridle didn't register its idle notification and sleep inhibitor\n";
+        return 1;
+    }
+
+    const auto            READY = std::chrono::steady_clock::now() - STARTED;
+
+    std::vector<uint64_t> idle, resume, sleep;
+
+    const auto            WAITMARK = [&harness](const std::string& tag) {
+        return harness.waitFor([&]() { return std::ranges::any_of(harness.marks, [&tag](const auto& m) { return m.tag == tag; }); }, EVENT_TIMEOUT);
+    };
+
+    const auto SINCE = [&harness](const std::string& tag, std::chrono::steady_clock::time_point begin) {
+        return toUs(std::ranges::find_if(harness.marks, [&tag](const auto& m) { return m.tag == tag; })->sent - begin);
+    };
+
+    for (size_t i = 0; i < iterations; ++i) {
+        harness.marks.clear();
+
+        auto begin = harness.sendIdled();
+        if (!WAITMARK("idle")) {
+            std::cerr << "Iteration " << i << ": the on-timeout command didn't run\n";
+            return 1;
+        }
+        idle.push_back(SINCE("idle", begin));
+
+        begin = harness.sendResumed();
+        if (!WAITMARK("resume")) {
+            std::cerr << "Iteration " << i << ": the on-resume command didn't run\n";
+            return 1;
+        }
+        resume.push_back(SINCE("resume", begin));
+
+        harness.lastInhibitorRelease.reset();
+        begin = harness.emitPrepareForSleep(true);
+        if (!harness.waitFor([&]() { return harness.lastInhibitorRelease.has_value(); }, EVENT_TIMEOUT)) {
+            std::cerr << "Iteration " << i << ": the sleep inhibitor wasn't released\n";
+            return 1;
+        }
+        sleep.push_back(toUs(*harness.lastInhibitorRelease - begin));
+
+        // and take it again, like after a resume from suspend
+        harness.emitPrepareForSleep(false);
+        if (!harness.waitFor([&]() { return harness.sleepInhibitorsHeld() > 0; }, EVENT_TIMEOUT)) {
+            std::cerr << "Iteration " << i << ": the sleep inhibitor wasn't taken again\n";
+            return 1;
+        }
+    }
+
+    std::cout << std::format("hypridle-bench: {} iterations against {}, ready after {}ms\n\n", iterations, options.hypridle,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(READY).count());
+    std::cout << std::format("{:<28}{:>8}{:>10}{:>10}{:>10}{:>10}\n", "latency (µs)", "count", "p50", "p90", "p99", "max");
+    std::cout << formatPercentiles("idle -> exec", percentiles(idle)) << "\n";
+    std::cout << formatPercentiles("resume -> exec", percentiles(resume)) << "\n";
+    std::cout << formatPercentiles("sleep inhibitor release", percentiles(sleep)) << "\n";
+
+    return 0;
+}
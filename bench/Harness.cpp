@@ -0,0 +1,497 @@
+#include "Harness.hpp"
+#include "ext-idle-notify-v1-server-protocol.h"
+
+#include <wayland-server.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char** environ;
+
+constexpr const char* SESSIONPATH = "/org/freedesktop/login1/session/bench";
+
+static const struct wl_seat_interface SEATIMPL = {
+    .get_pointer  = [](wl_client*, wl_resource*, uint32_t) {},
+    .get_keyboard = [](wl_client*, wl_resource*, uint32_t) {},
+    .get_touch    = [](wl_client*, wl_resource*, uint32_t) {},
+    .release      = [](wl_client*, wl_resource* r) { wl_resource_destroy(r); },
+};
+
+static const struct ext_idle_notifier_v1_interface NOTIFIERIMPL = {
+    .destroy               = [](wl_client*, wl_resource* r) { wl_resource_destroy(r); },
+    .get_idle_notification = CBenchHarness::getIdleNotification,
+};
+
+static const struct ext_idle_notification_v1_interface NOTIFICATIONIMPL = {
+    .destroy = [](wl_client*, wl_resource* r) { wl_resource_destroy(r); },
+};
+
+static pid_t spawn(const std::vector<std::string>& args, const std::vector<std::string>& env) {
+    std::vector<char*> argv;
+    for (auto& a : args) {
+        argv.push_back(const_cast<char*>(a.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    std::vector<char*> envp;
+    for (auto& e : env) {
+        envp.push_back(const_cast<char*>(e.c_str()));
+    }
+    envp.push_back(nullptr);
+
+    pid_t     pid = -1;
+    const int RET = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), env.empty() ? environ : envp.data());
+    if (RET != 0) {
+        std::cerr << "Couldn't run " << args[0] << ": " << strerror(RET) << "\n";
+        return -1;
+    }
+
+    return pid;
+}
+
+// waits for pid without blocking the harness, SIGKILLs it after timeout
+static void stopProcess(pid_t pid, std::chrono::milliseconds timeout, const std::function<void(std::chrono::milliseconds)>& pump) {
+    if (pid <= 0)
+        return;
+
+    kill(pid, SIGTERM);
+
+    const auto DEADLINE = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < DEADLINE) {
+        if (waitpid(pid, nullptr, WNOHANG) == pid)
+            return;
+
+        pump(std::chrono::milliseconds(10));
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+CBenchHarness::CBenchHarness() {
+    char templ[] = "/tmp/hypridle-bench-XXXXXX";
+    if (mkdtemp(templ))
+        m_dir = templ;
+}
+
+CBenchHarness::~CBenchHarness() {
+    stop();
+}
+
+const std::string& CBenchHarness::dir() const {
+    return m_dir;
+}
+
+const std::string& CBenchHarness::busAddress() const {
+    return m_busAddress;
+}
+
+pid_t CBenchHarness::hypridlePid() const {
+    return m_hypridlePid;
+}
+
+std::string CBenchHarness::markSocket() const {
+    return m_dir + "/mark.sock";
+}
+
+bool CBenchHarness::start(const SOptions& options) {
+    if (m_dir.empty()) {
+        std::cerr << "Couldn't create a temporary directory: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    return startBus() && startLogind() && startCompositor() && startMarkSocket() && startHypridle(options);
+}
+
+void CBenchHarness::stop() {
+    stopProcess(m_hypridlePid, std::chrono::seconds(5), [this](std::chrono::milliseconds t) { pump(t); });
+    m_hypridlePid = -1;
+
+    m_logindSession.reset();
+    m_logindManager.reset();
+    m_logindConnection.reset();
+
+    for (auto& i : m_inhibitors) {
+        close(i.fd);
+    }
+    m_inhibitors.clear();
+
+    if (m_display) {
+        wl_display_destroy_clients(m_display);
+        wl_display_destroy(m_display);
+        m_display = nullptr;
+    }
+
+    stopProcess(m_busPid, std::chrono::seconds(5), [](std::chrono::milliseconds t) { std::this_thread::sleep_for(t); });
+    m_busPid = -1;
+
+    if (m_markFd >= 0)
+        close(m_markFd);
+    m_markFd = -1;
+
+    if (!m_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::remove_all(m_dir, ec);
+        m_dir.clear();
+    }
+}
+
+bool CBenchHarness::startBus() {
+    const std::string SOCKET = m_dir + "/bus";
+    const std::string CONFIG = m_dir + "/bus.conf";
+
+    std::ofstream     ofs(CONFIG);
+    ofs << "<!DOCTYPE busconfig PUBLIC \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\"\n"
+           " \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+           "<busconfig>\n"
+           "  <type>session</type>\n"
+           "  <listen>unix:path="
+        << SOCKET
+        << "</listen>\n"
+           "  <auth>EXTERNAL</auth>\n"
+           "  <limit name=\"max_completed_connections\">100000</limit>\n"
+           "  <limit name=\"max_connections_per_user\">100000</limit>\n"
+           "  <limit name=\"max_incomplete_connections\">100000</limit>\n"
+           "  <policy context=\"default\">\n"
+           "    <allow send_destination=\"*\" eavesdrop=\"true\"/>\n"
+           "    <allow eavesdrop=\"true\"/>\n"
+           "    <allow own=\"*\"/>\n"
+           "  </policy>\n"
+           "</busconfig>\n";
+    ofs.close();
+
+    m_busPid = spawn({"dbus-daemon", "--nofork", "--config-file=" + CONFIG}, {});
+    if (m_busPid < 0)
+        return false;
+
+    m_busAddress = "unix:path=" + SOCKET;
+
+    for (int i = 0; i < 500; ++i) {
+        if (std::filesystem::exists(SOCKET))
+            return true;
+
+        if (waitpid(m_busPid, nullptr, WNOHANG) == m_busPid) {
+            std::cerr << "dbus-daemon exited during startup\n";
+            m_busPid = -1;
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::cerr << "dbus-daemon didn't create " << SOCKET << "\n";
+    return false;
+}
+
+bool CBenchHarness::startLogind() {
+    try {
+        m_logindConnection = sdbus::createSessionBusConnectionWithAddress(m_busAddress);
+        m_logindConnection->requestName(sdbus::ServiceName{"org.freedesktop.login1"});
+
+        m_logindManager = sdbus::createObject(*m_logindConnection, sdbus::ObjectPath{"/org/freedesktop/login1"});
+        m_logindManager
+            ->addVTable(sdbus::registerMethod("GetSession").implementedAs([](std::string id) { return sdbus::ObjectPath{SESSIONPATH}; }),
+                        sdbus::registerMethod("Inhibit").implementedAs([this](std::string what, std::string who, std::string why, std::string mode) {
+                            int fds[2];
+                            if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0)
+                                throw sdbus::Error(sdbus::Error::Name{"org.freedesktop.DBus.Error.Failed"}, strerror(errno));
+
+                            m_inhibitors.push_back({.fd = fds[0], .what = what});
+                            return sdbus::UnixFd{fds[1], sdbus::adopt_fd};
+                        }),
+                        sdbus::registerProperty("BlockInhibited").withGetter([]() { return std::string{}; }),
+                        sdbus::registerSignal("PrepareForSleep").withParameters<bool>())
+            .forInterface(sdbus::InterfaceName{"org.freedesktop.login1.Manager"});
+
+        m_logindSession = sdbus::createObject(*m_logindConnection, sdbus::ObjectPath{SESSIONPATH});
+        m_logindSession
+            ->addVTable(sdbus::registerMethod("Lock").implementedAs([]() {}), sdbus::registerMethod("Unlock").implementedAs([]() {}),
+                        sdbus::registerMethod("SetIdleHint").implementedAs([](bool) {}), sdbus::registerMethod("SetLockedHint").implementedAs([](bool) {}),
+                        sdbus::registerSignal("Lock"), sdbus::registerSignal("Unlock"))
+            .forInterface(sdbus::InterfaceName{"org.freedesktop.login1.Session"});
+    } catch (sdbus::Error& e) {
+        std::cerr << "Couldn't set up logind on the private bus: " << e.what() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CBenchHarness::startCompositor() {
+    // wl_display_add_socket_auto puts the socket into XDG_RUNTIME_DIR
+    setenv("XDG_RUNTIME_DIR", m_dir.c_str(), 1);
+
+    m_display = wl_display_create();
+    if (!m_display) {
+        std::cerr << "Couldn't create a wayland display\n";
+        return false;
+    }
+
+    const char* SOCKET = wl_display_add_socket_auto(m_display);
+    if (!SOCKET) {
+        std::cerr << "Couldn't add a wayland socket in " << m_dir << "\n";
+        return false;
+    }
+
+    m_waylandSocket = SOCKET;
+
+    if (!wl_global_create(m_display, &wl_seat_interface, 5, this, CBenchHarness::bindSeat) ||
+        !wl_global_create(m_display, &ext_idle_notifier_v1_interface, 1, this, CBenchHarness::bindIdleNotifier)) {
+        std::cerr << "Couldn't create the compositor globals\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CBenchHarness::startMarkSocket() {
+    m_markFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, markSocket().c_str(), sizeof(addr.sun_path) - 1);
+
+    if (m_markFd < 0 || bind(m_markFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Couldn't bind " << markSocket() << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CBenchHarness::startHypridle(const SOptions& options) {
+    const std::string CONFIG = m_dir + "/hypridle.conf";
+    std::ofstream(CONFIG) << options.config;
+
+    // the bus address and display are ours, and nothing of the session we run in should leak into the daemon
+    static const std::vector<std::string> OVERRIDDEN = {"WAYLAND_DISPLAY",         "XDG_RUNTIME_DIR", "DBUS_SYSTEM_BUS_ADDRESS", "DBUS_SESSION_BUS_ADDRESS",
+                                                        "HYPRIDLE_SOCKET",         "NOTIFY_SOCKET",   "WATCHDOG_USEC",           "WATCHDOG_PID",
+                                                        "HYPRLAND_INSTANCE_SIGNATURE"};
+
+    std::vector<std::string> env;
+    for (char** e = environ; *e; ++e) {
+        const std::string_view VAR  = *e;
+        const auto             NAME = VAR.substr(0, VAR.find('='));
+        if (std::ranges::find(OVERRIDDEN, NAME) == OVERRIDDEN.end())
+            env.emplace_back(VAR);
+    }
+
+    env.push_back("WAYLAND_DISPLAY=" + m_waylandSocket);
+    env.push_back("XDG_RUNTIME_DIR=" + m_dir);
+    env.push_back("DBUS_SYSTEM_BUS_ADDRESS=" + m_busAddress);
+    env.push_back("DBUS_SESSION_BUS_ADDRESS=" + m_busAddress);
+    env.push_back("HYPRIDLE_SOCKET=" + m_dir + "/hypridle.sock");
+
+    m_hypridlePid = spawn({options.hypridle, options.verbose ? "--verbose" : "--quiet", "--config", CONFIG}, env);
+    return m_hypridlePid > 0;
+}
+
+void CBenchHarness::bindSeat(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &wl_seat_interface, version, id);
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &SEATIMPL, data, nullptr);
+
+    wl_seat_send_capabilities(RESOURCE, 0);
+    if (version >= WL_SEAT_NAME_SINCE_VERSION)
+        wl_seat_send_name(RESOURCE, "seat0");
+}
+
+void CBenchHarness::bindIdleNotifier(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &ext_idle_notifier_v1_interface, version, id);
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &NOTIFIERIMPL, data, nullptr);
+}
+
+void CBenchHarness::getIdleNotification(wl_client* client, wl_resource* resource, uint32_t id, uint32_t timeout, wl_resource* seat) {
+    const auto SELF     = (CBenchHarness*)wl_resource_get_user_data(resource);
+    const auto RESOURCE = wl_resource_create(client, &ext_idle_notification_v1_interface, wl_resource_get_version(resource), id);
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &NOTIFICATIONIMPL, SELF, CBenchHarness::destroyNotification);
+    SELF->m_notifications.push_back({.resource = RESOURCE, .timeoutMs = timeout});
+}
+
+void CBenchHarness::destroyNotification(wl_resource* resource) {
+    const auto SELF = (CBenchHarness*)wl_resource_get_user_data(resource);
+    std::erase_if(SELF->m_notifications, [resource](const auto& n) { return n.resource == resource; });
+}
+
+size_t CBenchHarness::idleNotifications() const {
+    return m_notifications.size();
+}
+
+std::chrono::steady_clock::time_point CBenchHarness::sendIdled() {
+    const auto NOW = std::chrono::steady_clock::now();
+    for (auto& n : m_notifications) {
+        ext_idle_notification_v1_send_idled(n.resource);
+    }
+    wl_display_flush_clients(m_display);
+    return NOW;
+}
+
+std::chrono::steady_clock::time_point CBenchHarness::sendResumed() {
+    const auto NOW = std::chrono::steady_clock::now();
+    for (auto& n : m_notifications) {
+        ext_idle_notification_v1_send_resumed(n.resource);
+    }
+    wl_display_flush_clients(m_display);
+    return NOW;
+}
+
+size_t CBenchHarness::sleepInhibitorsHeld() const {
+    return m_inhibitors.size();
+}
+
+std::chrono::steady_clock::time_point CBenchHarness::emitPrepareForSleep(bool toSleep) {
+    const auto NOW = std::chrono::steady_clock::now();
+    m_logindManager->emitSignal("PrepareForSleep").onInterface("org.freedesktop.login1.Manager").withArguments(toSleep);
+    while (m_logindConnection->processPendingEvent()) {
+        ;
+    }
+    return NOW;
+}
+
+void CBenchHarness::readMarks() {
+    char buf[256];
+    while (true) {
+        const ssize_t LEN = recv(m_markFd, buf, sizeof(buf) - 1, 0);
+        if (LEN <= 0)
+            break;
+
+        // "<tag> <steady_clock ns>", see Mark.cpp
+        const std::string_view MSG   = {buf, (size_t)LEN};
+        const auto             SPACE = MSG.find(' ');
+        if (SPACE == std::string_view::npos)
+            continue;
+
+        try {
+            const auto NS = std::stoll(std::string{MSG.substr(SPACE + 1)});
+            marks.push_back({.tag = std::string{MSG.substr(0, SPACE)}, .sent = std::chrono::steady_clock::time_point{std::chrono::nanoseconds{NS}}});
+        } catch (...) { std::cerr << "Ignoring a malformed mark\n"; }
+    }
+}
+
+void CBenchHarness::checkInhibitors() {
+    for (auto it = m_inhibitors.begin(); it != m_inhibitors.end();) {
+        pollfd pfd = {.fd = it->fd, .events = POLLIN};
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR))) {
+            lastInhibitorRelease = std::chrono::steady_clock::now();
+            close(it->fd);
+            it = m_inhibitors.erase(it);
+        } else
+            ++it;
+    }
+}
+
+void CBenchHarness::pump(std::chrono::milliseconds timeout) {
+    if (!m_display || !m_logindConnection) {
+        std::this_thread::sleep_for(timeout);
+        return;
+    }
+
+    const auto          LOOP = wl_display_get_event_loop(m_display);
+    const auto          BUS  = m_logindConnection->getEventLoopPollData();
+
+    std::vector<pollfd> fds = {
+        {.fd = wl_event_loop_get_fd(LOOP), .events = POLLIN},
+        {.fd = BUS.fd, .events = BUS.events},
+        {.fd = m_markFd, .events = POLLIN},
+    };
+    if (BUS.eventFd >= 0)
+        fds.push_back({.fd = BUS.eventFd, .events = POLLIN});
+    for (auto& i : m_inhibitors) {
+        fds.push_back({.fd = i.fd, .events = POLLIN});
+    }
+
+    int timeoutMs = timeout.count();
+    if (const int BUSTIMEOUT = BUS.getPollTimeout(); BUSTIMEOUT >= 0)
+        timeoutMs = std::min(timeoutMs, BUSTIMEOUT);
+
+    if (poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR)
+        std::cerr << "poll failed: " << strerror(errno) << "\n";
+
+    wl_event_loop_dispatch(LOOP, 0);
+    wl_display_flush_clients(m_display);
+
+    while (m_logindConnection->processPendingEvent()) {
+        ;
+    }
+
+    readMarks();
+    checkInhibitors();
+}
+
+bool CBenchHarness::hypridleAlive() {
+    if (m_hypridlePid <= 0)
+        return false;
+
+    int status = 0;
+    if (waitpid(m_hypridlePid, &status, WNOHANG) != m_hypridlePid)
+        return true;
+
+    if (WIFSIGNALED(status))
+        std::cerr << "hypridle was killed by signal " << WTERMSIG(status) << "\n";
+    else
+        std::cerr << "hypridle exited with " << WEXITSTATUS(status) << "\n";
+
+    m_hypridlePid = -1;
+    return false;
+}
+
+bool CBenchHarness::waitFor(const std::function<bool()>& pred, std::chrono::milliseconds timeout) {
+    const auto DEADLINE = std::chrono::steady_clock::now() + timeout;
+
+    while (!pred()) {
+        const auto NOW = std::chrono::steady_clock::now();
+        if (NOW >= DEADLINE || !hypridleAlive())
+            return false;
+
+        pump(std::min(std::chrono::duration_cast<std::chrono::milliseconds>(DEADLINE - NOW), std::chrono::milliseconds(100)));
+    }
+
+    return true;
+}
+
+uint64_t toUs(std::chrono::steady_clock::duration d) {
+    return std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count(), 0);
+}
+
+SPercentiles percentiles(std::vector<uint64_t> samplesUs) {
+    if (samplesUs.empty())
+        return {};
+
+    std::ranges::sort(samplesUs);
+
+    // nearest rank
+    const auto AT = [&samplesUs](double p) { return samplesUs[std::max<size_t>(std::ceil(p * samplesUs.size()), 1) - 1]; };
+
+    return {.count = samplesUs.size(), .p50 = AT(0.5), .p90 = AT(0.9), .p99 = AT(0.99), .max = samplesUs.back()};
+}
+
+std::string formatPercentiles(const std::string& name, const SPercentiles& p) {
+    return std::format("{:<28}{:>8}{:>10}{:>10}{:>10}{:>10}", name, p.count, p.p50, p.p90, p.p99, p.max);
+}
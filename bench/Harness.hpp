@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sdbus-c++/sdbus-c++.h>
+
+struct wl_display;
+struct wl_resource;
+
+// Runs a real hypridle binary against stand-ins for everything it talks to: a private dbus-daemon (as both system and session bus),
+// a fake logind on it and a minimal wayland compositor with wl_seat and ext-idle-notify-v1. Everything is serviced from pump(),
+// which the benches call in a loop, so there are no threads here.
+class CBenchHarness {
+  public:
+    CBenchHarness();
+    ~CBenchHarness();
+
+    struct SOptions {
+        std::string hypridle;
+        std::string config; // contents, written to the temp dir
+        bool        verbose = false;
+    };
+
+    // starts the bus, logind and the compositor, then hypridle. Returns false with the reason logged to stderr.
+    bool                         start(const SOptions& options);
+    void                         stop();
+
+    const std::string&           dir() const;
+    const std::string&           busAddress() const;
+    pid_t                        hypridlePid() const;
+
+    // polls everything once, for at most timeout
+    void                         pump(std::chrono::milliseconds timeout);
+    // pumps until pred holds, false on timeout or when hypridle exited
+    bool                         waitFor(const std::function<bool()>& pred, std::chrono::milliseconds timeout);
+    bool                         hypridleAlive();
+
+    // compositor
+    size_t                       idleNotifications() const;
+    // sends idled/resumed to every idle notification, returns when it was flushed
+    std::chrono::steady_clock::time_point sendIdled();
+    std::chrono::steady_clock::time_point sendResumed();
+
+    // logind
+    size_t                       sleepInhibitorsHeld() const;
+    std::chrono::steady_clock::time_point emitPrepareForSleep(bool toSleep);
+    // set when the last held inhibitor got closed
+    std::optional<std::chrono::steady_clock::time_point> lastInhibitorRelease;
+
+    // marks are datagrams from hypridle-bench-mark, sent by listener commands
+    struct SMark {
+        std::string                           tag;
+        std::chrono::steady_clock::time_point sent;
+    };
+    std::vector<SMark> marks;
+    std::string        markSocket() const;
+
+    // compositor request handlers
+    static void bindSeat(struct wl_client* client, void* data, uint32_t version, uint32_t id);
+    static void bindIdleNotifier(struct wl_client* client, void* data, uint32_t version, uint32_t id);
+    static void getIdleNotification(struct wl_client* client, wl_resource* resource, uint32_t id, uint32_t timeout, wl_resource* seat);
+    static void destroyNotification(wl_resource* resource);
+
+  private:
+    struct SNotification {
+        wl_resource* resource = nullptr;
+        uint32_t     timeoutMs = 0;
+    };
+
+    struct SInhibitor {
+        int         fd = -1; // read end, hangs up when hypridle closes its end
+        std::string what;
+    };
+
+    bool                                    startBus();
+    bool                                    startCompositor();
+    bool                                    startLogind();
+    bool                                    startHypridle(const SOptions& options);
+    bool                                    startMarkSocket();
+
+    void                                    readMarks();
+    void                                    checkInhibitors();
+
+    std::string                             m_dir;
+    std::string                             m_busAddress;
+    pid_t                                   m_busPid      = -1;
+    pid_t                                   m_hypridlePid = -1;
+    int                                     m_markFd      = -1;
+
+    wl_display*                             m_display = nullptr;
+    std::string                             m_waylandSocket;
+    std::vector<SNotification>              m_notifications;
+
+    std::unique_ptr<sdbus::IConnection>     m_logindConnection;
+    std::unique_ptr<sdbus::IObject>         m_logindManager;
+    std::unique_ptr<sdbus::IObject>         m_logindSession;
+    std::vector<SInhibitor>                 m_inhibitors;
+};
+
+struct SPercentiles {
+    size_t   count = 0;
+    uint64_t p50 = 0, p90 = 0, p99 = 0, max = 0; // µs
+};
+
+SPercentiles percentiles(std::vector<uint64_t> samplesUs);
+std::string  formatPercentiles(const std::string& name, const SPercentiles& p);
+uint64_t     toUs(std::chrono::steady_clock::duration d);
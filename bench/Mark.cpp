@@ -0,0 +1,27 @@
+// Run by hypridle as a listener command, tells the bench when the command started. Kept free of any deps so it starts as fast as
+// a command can.
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+    const auto NOW = std::chrono::steady_clock::now();
+
+    if (argc < 3)
+        return 1;
+
+    const std::string MSG = std::string{argv[2]} + " " + std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(NOW.time_since_epoch()).count());
+
+    sockaddr_un       addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+
+    const int FD = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (FD < 0 || sendto(FD, MSG.data(), MSG.size(), 0, (sockaddr*)&addr, sizeof(addr)) < 0)
+        return 1;
+
+    close(FD);
+    return 0;
+}
@@ -0,0 +1,246 @@
+// Hammers the ScreenSaver interface of a real hypridle with hundreds of clients on a private bus, then checks that every inhibit got undone.
+#include "Harness.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <thread>
+
+static const char* USAGE = R"#(Usage: hypridle-stress [options]
+
+Runs hypridle against a stand-in compositor and a fake logind on a private dbus-daemon, lets many clients
+call ScreenSaver Inhibit/UnInhibit at once and reports calls/s, reply latency and hypridle's RSS.
+Every tenth client disconnects while still holding its cookies. Fails if any inhibit is left afterwards.
+
+Options:
+  --hypridle <path>         The hypridle binary to stress (default: the one built alongside)
+  -c, --clients <n>         Clients, each on its own connection (default: 200)
+  -r, --rounds <n>          Inhibit/UnInhibit rounds per client (default: 50)
+  -b, --burst <n>           Cookies a client holds at once per round, like a browser with several tabs (default: 4)
+  -v, --verbose             Let hypridle log verbosely
+  -h, --help                Show this help message
+)#";
+
+struct SClientResult {
+    std::vector<uint64_t> latencyUs;
+    size_t                failures = 0;
+};
+
+static void runClient(const std::string& address, size_t rounds, size_t burst, bool leak, SClientResult& result, std::latch& ready) {
+    std::unique_ptr<sdbus::IConnection> connection;
+    std::unique_ptr<sdbus::IProxy>      proxy;
+
+    try {
+        connection = sdbus::createSessionBusConnectionWithAddress(address);
+        proxy      = sdbus::createProxy(*connection, sdbus::ServiceName{"org.freedesktop.ScreenSaver"}, sdbus::ObjectPath{"/org/freedesktop/ScreenSaver"});
+    } catch (sdbus::Error& e) {
+        std::cerr << "Client couldn't connect: " << e.what() << "\n";
+        result.failures++;
+        ready.count_down();
+        return;
+    }
+
+    // everyone starts at once
+    ready.arrive_and_wait();
+
+    const auto CALL = [&](auto&& fn) {
+        const auto BEGIN = std::chrono::steady_clock::now();
+        try {
+            fn();
+        } catch (sdbus::Error&) {
+            result.failures++;
+            return;
+        }
+        result.latencyUs.push_back(toUs(std::chrono::steady_clock::now() - BEGIN));
+    };
+
+    std::vector<uint32_t> cookies;
+    for (size_t round = 0; round < rounds; ++round) {
+        cookies.clear();
+
+        for (size_t i = 0; i < burst; ++i) {
+            CALL([&]() {
+                uint32_t cookie = 0;
+                proxy->callMethod("Inhibit").onInterface("org.freedesktop.ScreenSaver").withArguments(std::string{"hypridle-stress"}, std::string{"stress"}).storeResultsTo(cookie);
+                cookies.push_back(cookie);
+            });
+        }
+
+        // the last round of a leaking client is left for hypridle to clean up when we disconnect
+        if (leak && round + 1 == rounds)
+            break;
+
+        for (const auto c : cookies) {
+            CALL([&]() { proxy->callMethod("UnInhibit").onInterface("org.freedesktop.ScreenSaver").withArguments(c); });
+        }
+    }
+}
+
+// VmRSS and VmHWM in kB
+static std::pair<uint64_t, uint64_t> memoryOf(pid_t pid) {
+    std::ifstream ifs(std::format("/proc/{}/status", pid));
+    std::string   line;
+    uint64_t      rss = 0, hwm = 0;
+
+    while (std::getline(ifs, line)) {
+        if (line.starts_with("VmRSS:"))
+            rss = std::stoull(line.substr(6));
+        else if (line.starts_with("VmHWM:"))
+            hwm = std::stoull(line.substr(6));
+    }
+
+    return {rss, hwm};
+}
+
+int main(int argc, char** argv) {
+    CBenchHarness::SOptions options = {.hypridle = HYPRIDLE_BENCH_HYPRIDLE};
+    size_t                  clients = 200, rounds = 50, burst = 4;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string ARG = argv[i];
+
+        const auto        COUNT = [&](size_t& out) {
+            try {
+                out = std::max(std::stoul(argv[++i]), 1UL);
+                return true;
+            } catch (...) {
+                std::cerr << "Invalid count " << argv[i] << " for " << ARG << "\n";
+                return false;
+            }
+        };
+
+        if (ARG == "--help" || ARG == "-h") {
+            std::cout << USAGE;
+            return 0;
+        } else if (ARG == "--verbose" || ARG == "-v")
+            options.verbose = true;
+        else if (ARG == "--hypridle" && i + 1 < argc)
+            options.hypridle = argv[++i];
+        else if ((ARG == "--clients" || ARG == "-c") && i + 1 < argc) {
+            if (!COUNT(clients))
+                return 1;
+        } else if ((ARG == "--rounds" || ARG == "-r") && i + 1 < argc) {
+            if (!COUNT(rounds))
+                return 1;
+        } else if ((ARG == "--burst" || ARG == "-b") && i + 1 < argc) {
+            if (!COUNT(burst))
+                return 1;
+        } else {
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+
+    // nothing here runs commands, the listener is only there so hypridle has something to arm
+    options.config = R"#(general {
+    inhibit_sleep = 0
+}
+
+listener {
+    timeout = 300
+}
+)#";
+
+    CBenchHarness harness;
+    if (!harness.start(options))
+        return 1;
+
+    std::unique_ptr<sdbus::IConnection> connection;
+    std::unique_ptr<sdbus::IProxy>      bus, metrics;
+
+    try {
+        connection = sdbus::createSessionBusConnectionWithAddress(harness.busAddress());
+        bus        = sdbus::createProxy(*connection, sdbus::ServiceName{"org.freedesktop.DBus"}, sdbus::ObjectPath{"/org/freedesktop/DBus"});
+        metrics    = sdbus::createProxy(*connection, sdbus::ServiceName{"org.hyprland.Hypridle"}, sdbus::ObjectPath{"/org/hyprland/Hypridle"});
+    } catch (sdbus::Error& e) {
+        std::cerr << "Couldn't connect to the private bus: " << e.what() << "\n";
+        return 1;
+    }
+
+    const auto SCREENSAVEROWNED = [&]() {
+        bool owned = false;
+        try {
+            bus->callMethod("NameHasOwner").onInterface("org.freedesktop.DBus").withArguments(std::string{"org.freedesktop.ScreenSaver"}).storeResultsTo(owned);
+        } catch (sdbus::Error&) {}
+        return owned;
+    };
+
+    const auto INHIBITLOCKS = [&]() -> std::optional<int64_t> {
+        try {
+            const sdbus::Variant VALUE = metrics->getProperty("InhibitLocks").onInterface("org.hyprland.Hypridle.Metrics");
+            return VALUE.get<int64_t>();
+        } catch (sdbus::Error&) { return std::nullopt; }
+    };
+
+    if (!harness.waitFor([&]() { return harness.idleNotifications() > 0 && SCREENSAVEROWNED(); }, std::chrono::seconds(10))) {
+        std::cerr << "hypridle didn't take org.freedesktop.ScreenSaver\n";
+        return 1;
+    }
+
+    const auto                 MEMBEFORE = memoryOf(harness.hypridlePid());
+
+    std::vector<SClientResult> results(clients);
+    std::vector<std::thread>   threads;
+    std::latch                 ready(clients + 1);
+    std::atomic<size_t>        finished = 0;
+
+    for (size_t i = 0; i < clients; ++i) {
+        threads.emplace_back([&, i]() {
+            runClient(harness.busAddress(), rounds, burst, i % 10 == 9, results[i], ready);
+            finished++;
+        });
+    }
+
+    // the clients only talk to hypridle, but hypridle may talk to the compositor and logind meanwhile
+    ready.count_down();
+    const auto BEGIN = std::chrono::steady_clock::now();
+    harness.waitFor([&]() { return finished == clients; }, std::chrono::minutes(10));
+    const auto ELAPSED = std::chrono::steady_clock::now() - BEGIN;
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // disconnected clients are cleaned up once NameOwnerChanged arrives
+    std::optional<int64_t> locks;
+    harness.waitFor(
+        [&]() {
+            locks = INHIBITLOCKS();
+            return locks == 0;
+        },
+        std::chrono::seconds(5));
+
+    const auto            MEMAFTER = memoryOf(harness.hypridlePid());
+
+    std::vector<uint64_t> latency;
+    size_t                failures = 0;
+    for (auto& r : results) {
+        latency.insert(latency.end(), r.latencyUs.begin(), r.latencyUs.end());
+        failures += r.failures;
+    }
+
+    const double SECONDS = std::chrono::duration<double>(ELAPSED).count();
+
+    std::cout << std::format("hypridle-stress: {} clients x {} rounds x {} cookies against {}\n\n", clients, rounds, burst, options.hypridle);
+    std::cout << std::format("{} calls in {:.2f}s, {:.0f} calls/s, {} failed\n", latency.size(), SECONDS, latency.size() / SECONDS, failures);
+    std::cout << std::format("{:<28}{:>8}{:>10}{:>10}{:>10}{:>10}\n", "latency (µs)", "count", "p50", "p90", "p99", "max");
+    std::cout << formatPercentiles("Inhibit/UnInhibit reply", percentiles(latency)) << "\n\n";
+    std::cout << std::format("hypridle RSS {} kB before, {} kB after, {} kB peak\n", MEMBEFORE.first, MEMAFTER.first, MEMAFTER.second);
+
+    if (!harness.hypridleAlive()) {
+        std::cerr << "FAIL: hypridle didn't survive\n";
+        return 1;
+    }
+
+    if (locks != 0) {
+        std::cerr << "FAIL: " << (locks ? std::to_string(*locks) : std::string{"unknown"}) << " inhibit locks left, expected 0\n";
+        return 1;
+    }
+
+    std::cout << "inhibit locks back to 0\n";
+    return failures > 0 ? 1 : 0;
+}
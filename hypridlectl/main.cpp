@@ -0,0 +1,103 @@
+#include "../src/helpers/MiscFunctions.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static const char* USAGE = R"#(Usage: hypridlectl [options] <command> [args]
+
+Commands:
+  status                    Idle, lock and inhibit state and the state of every seat and listener
+  idle                      "yes" if any seat is idle, "no" otherwise
+  inhibit <seconds> [why]   Inhibit idle for a while, prints an id for uninhibit
+  uninhibit <id>            Drop an inhibit added with inhibit
+  fire <listener>           Run the on-timeout of a listener (by index, see status) right away
+  reset <listener>          Forget that a listener fired, its on-resume won't run
+  reload                    Reload the config
+
+Options:
+  -s, --socket <path>       Talk to the hypridle listening on path
+  -h, --help                Show this help message
+)#";
+
+int main(int argc, char** argv) {
+    std::string socketPath = controlSocketPath();
+    std::string request;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string ARG = argv[i];
+
+        if (request.empty() && (ARG == "--help" || ARG == "-h")) {
+            std::cout << USAGE;
+            return 0;
+        }
+
+        if (request.empty() && (ARG == "--socket" || ARG == "-s")) {
+            if (i + 1 >= argc) {
+                std::cerr << "After " << ARG << " you should provide a socket path.\n";
+                return 1;
+            }
+
+            socketPath = argv[++i];
+            continue;
+        }
+
+        if (!request.empty())
+            request += ' ';
+        request += ARG;
+    }
+
+    if (request.empty()) {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    if (socketPath.empty()) {
+        std::cerr << "XDG_RUNTIME_DIR isn't set, pass the socket with --socket or HYPRIDLE_SOCKET\n";
+        return 1;
+    }
+
+    request += '\n';
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path " << socketPath << " is too long\n";
+        return 1;
+    }
+
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int FD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (FD < 0 || connect(FD, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Couldn't connect to " << socketPath << " (" << strerror(errno) << "), is hypridle running?\n";
+        return 1;
+    }
+
+    if (send(FD, request.data(), request.size(), MSG_NOSIGNAL) < 0) {
+        std::cerr << "Failed to send the request: " << strerror(errno) << "\n";
+        close(FD);
+        return 1;
+    }
+
+    std::string reply;
+    char        buf[1024];
+    ssize_t     len = 0;
+
+    // hypridle closes the connection after replying
+    while ((len = read(FD, buf, sizeof(buf))) > 0) {
+        reply.append(buf, len);
+    }
+
+    close(FD);
+
+    if (reply.starts_with("error: ")) {
+        std::cerr << reply;
+        return 1;
+    }
+
+    std::cout << reply;
+    return 0;
+}
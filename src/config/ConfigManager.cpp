@@ -2,6 +2,7 @@
 #include "../helpers/Log.hpp"
 #include "../helpers/MiscFunctions.hpp"
 #include <hyprutils/path/Path.hpp>
+#include <algorithm>
 #include <filesystem>
 #include <glob.h>
 #include <cstring>
@@ -60,6 +61,13 @@ void CConfigManager::init() {
     m_config.addSpecialConfigValue("listener", "on-timeout", Hyprlang::STRING{""});
     m_config.addSpecialConfigValue("listener", "on-resume", Hyprlang::STRING{""});
     m_config.addSpecialConfigValue("listener", "ignore_inhibit", Hyprlang::INT{0});
+    m_config.addSpecialConfigValue("listener", "deadline", Hyprlang::INT{0});
+    m_config.addSpecialConfigValue("listener", "cancel_on_resume", Hyprlang::INT{0});
+    m_config.addSpecialConfigValue("listener", "min_idle_ms", Hyprlang::INT{0});
+    m_config.addSpecialConfigValue("listener", "resume_grace_ms", Hyprlang::INT{0});
+    m_config.addSpecialConfigValue("listener", "id", Hyprlang::STRING{""});
+    m_config.addSpecialConfigValue("listener", "after", Hyprlang::STRING{""});
+    m_config.addSpecialConfigValue("listener", "seat", Hyprlang::STRING{""});
 
     m_config.addConfigValue("general:lock_cmd", Hyprlang::STRING{""});
     m_config.addConfigValue("general:unlock_cmd", Hyprlang::STRING{""});
@@ -71,14 +79,41 @@ void CConfigManager::init() {
     m_config.addConfigValue("general:ignore_systemd_inhibit", Hyprlang::INT{0});
     m_config.addConfigValue("general:ignore_wayland_inhibit", Hyprlang::INT{0});
     m_config.addConfigValue("general:inhibit_sleep", Hyprlang::INT{2});
-
-    // track the file in the circular dependency chain
-    alreadyIncludedSourceFiles.insert(std::filesystem::canonical(configHeadPath));
+    m_config.addConfigValue("general:max_processes", Hyprlang::INT{32});
+    m_config.addConfigValue("general:derive_idle_tiers", Hyprlang::INT{0});
+    m_config.addConfigValue("general:action_concurrency", Hyprlang::INT{0});
+    m_config.addConfigValue("general:backlight_fade_ms", Hyprlang::INT{0});
+    m_config.addConfigValue("general:sysfs_root", Hyprlang::STRING{"/sys"});
+    m_config.addConfigValue("general:hyprland_socket", Hyprlang::STRING{""});
 
     m_config.registerHandler(&::handleSource, "source", {.allowFlags = false});
 
     m_config.commence();
 
+    parse();
+}
+
+bool CConfigManager::reload() {
+    Debug::log(LOG, "Reloading config {}", configHeadPath);
+
+    std::error_code ec;
+    if (!std::filesystem::exists(configHeadPath, ec)) {
+        Debug::log(ERR, "Config file {} is gone, keeping the current config", configHeadPath);
+        return false;
+    }
+
+    parse();
+    return true;
+}
+
+void CConfigManager::parse() {
+    m_vRules.clear();
+    alreadyIncludedSourceFiles.clear();
+    configCurrentPath = configHeadPath;
+
+    // track the file in the circular dependency chain
+    alreadyIncludedSourceFiles.insert(std::filesystem::canonical(configHeadPath));
+
     auto result = m_config.parse();
 
     if (result.error)
@@ -108,7 +143,41 @@ Hyprlang::CParseResult CConfigManager::postParse() {
         rule.onTimeout = std::any_cast<Hyprlang::STRING>(m_config.getSpecialConfigValue("listener", "on-timeout", k.c_str()));
         rule.onResume  = std::any_cast<Hyprlang::STRING>(m_config.getSpecialConfigValue("listener", "on-resume", k.c_str()));
 
-        rule.ignoreInhibit = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "ignore_inhibit", k.c_str()));
+        rule.ignoreInhibit  = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "ignore_inhibit", k.c_str()));
+        rule.cancelOnResume = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "cancel_on_resume", k.c_str()));
+
+        Hyprlang::INT deadline = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "deadline", k.c_str()));
+        if (deadline < 0) {
+            result.setError("deadline can't be negative");
+            deadline = 0;
+        }
+        rule.deadline = deadline;
+
+        Hyprlang::INT minIdle     = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "min_idle_ms", k.c_str()));
+        Hyprlang::INT resumeGrace = std::any_cast<Hyprlang::INT>(m_config.getSpecialConfigValue("listener", "resume_grace_ms", k.c_str()));
+        if (minIdle < 0 || resumeGrace < 0) {
+            result.setError("min_idle_ms and resume_grace_ms can't be negative");
+            minIdle     = std::max<Hyprlang::INT>(minIdle, 0);
+            resumeGrace = std::max<Hyprlang::INT>(resumeGrace, 0);
+        }
+        rule.minIdleMs     = minIdle;
+        rule.resumeGraceMs = resumeGrace;
+
+        rule.id = std::any_cast<Hyprlang::STRING>(m_config.getSpecialConfigValue("listener", "id", k.c_str()));
+
+        // after = dpms, kbd
+        const std::string AFTER = std::any_cast<Hyprlang::STRING>(m_config.getSpecialConfigValue("listener", "after", k.c_str()));
+        for (size_t pos = 0; pos < AFTER.size();) {
+            const auto START = AFTER.find_first_not_of(", \t", pos);
+            if (START == std::string::npos)
+                break;
+
+            const auto END = AFTER.find_first_of(", \t", START);
+            rule.after.emplace_back(AFTER.substr(START, END - START));
+            pos = END;
+        }
+
+        rule.seat = std::any_cast<Hyprlang::STRING>(m_config.getSpecialConfigValue("listener", "seat", k.c_str()));
 
         if (timeout == -1) {
             result.setError("Category has a missing timeout setting");
@@ -118,18 +187,122 @@ Hyprlang::CParseResult CConfigManager::postParse() {
         m_vRules.emplace_back(rule);
     }
 
+    for (const auto NAME : {"lock_cmd", "unlock_cmd", "on_lock_cmd", "on_unlock_cmd", "before_sleep_cmd", "after_sleep_cmd"}) {
+        const std::string COMMAND = std::any_cast<Hyprlang::STRING>(m_config.getConfigValue((std::string{"general:"} + NAME).c_str()));
+        if (const auto ACTION = parseAction(COMMAND); !ACTION)
+            result.setError(std::format("general:{}: {}", NAME, ACTION.error()).c_str());
+    }
+
     for (auto& r : m_vRules) {
-        Debug::log(LOG, "Registered timeout rule for {}s:\n      on-timeout: {}\n      on-resume: {}\n      ignore_inhibit: {}", r.timeout, r.onTimeout, r.onResume,
-                   r.ignoreInhibit);
+        for (const auto& command : {r.onTimeout, r.onResume}) {
+            if (const auto ACTION = parseAction(command); !ACTION)
+                result.setError(std::format("listener with timeout {}: {}", r.timeout, ACTION.error()).c_str());
+        }
+
+        std::string after;
+        for (const auto& dep : r.after) {
+            if (dep == r.id || std::ranges::none_of(m_vRules, [&dep](const auto& other) { return other.id == dep; }))
+                result.setError(std::format("listener after = {} doesn't name another listener's id", dep).c_str());
+
+            after += (after.empty() ? "" : ", ") + dep;
+        }
+
+        Debug::log(LOG,
+                   "Registered timeout rule for {}s:\n      on-timeout: {}\n      on-resume: {}\n      ignore_inhibit: {}\n      deadline: {}s\n      cancel_on_resume: {}\n      "
+                   "min_idle_ms: {}\n      resume_grace_ms: {}\n      id: {}\n      after: {}\n      seat: {}",
+                   r.timeout, r.onTimeout, r.onResume, r.ignoreInhibit, r.deadline, r.cancelOnResume, r.minIdleMs, r.resumeGraceMs, r.id, after, r.seat.empty() ? "all" : r.seat);
     }
 
     return result;
 }
 
-std::vector<CConfigManager::STimeoutRule> CConfigManager::getRules() {
+static bool isBrightnessValue(const std::string& value) {
+    const bool PERCENT = value.ends_with('%');
+    const auto DIGITS  = std::string_view{value}.substr(0, value.size() - PERCENT);
+
+    if (DIGITS.empty() || !std::ranges::all_of(DIGITS, [](char c) { return c >= '0' && c <= '9'; }) || DIGITS.size() > 9)
+        return false;
+
+    return !PERCENT || std::stoi(std::string{DIGITS}) <= 100;
+}
+
+std::expected<CConfigManager::SAction, std::string> CConfigManager::parseAction(const std::string& command) {
+    SAction    action;
+
+    const auto COLON = command.find(':');
+    if (COLON == std::string::npos || COLON > command.find_first_of(" \t"))
+        return action;
+
+    const auto TYPE = command.substr(0, COLON);
+    if (TYPE == "backlight")
+        action.type = SAction::ACTION_BACKLIGHT;
+    else if (TYPE == "logind")
+        action.type = SAction::ACTION_LOGIND;
+    else if (TYPE == "hyprctl")
+        action.type = SAction::ACTION_HYPRCTL;
+    else
+        return action; // just a command with a colon in it
+
+    std::vector<std::string> words;
+    for (size_t pos = COLON + 1; pos < command.size();) {
+        const auto START = command.find_first_not_of(" \t", pos);
+        if (START == std::string::npos)
+            break;
+
+        const auto END = command.find_first_of(" \t", START);
+        words.emplace_back(command.substr(START, END - START));
+        pos = END;
+    }
+
+    if (words.empty())
+        return std::unexpected(std::format("{}: is missing a verb", TYPE));
+
+    action.verb = words.front();
+    action.args.assign(words.begin() + 1, words.end());
+
+    switch (action.type) {
+        case SAction::ACTION_BACKLIGHT: {
+            if (action.verb == "dim" || action.verb == "set") {
+                if (action.args.empty() || action.args.size() > 2 || !isBrightnessValue(action.args[0]))
+                    return std::unexpected(std::format("usage: backlight:{} <value|percent%> [device]", action.verb));
+            } else if (action.verb == "restore") {
+                if (action.args.size() > 1)
+                    return std::unexpected("usage: backlight:restore [device]");
+            } else
+                return std::unexpected(std::format("unknown backlight verb {}", action.verb));
+        } break;
+        case SAction::ACTION_LOGIND: {
+            if (action.verb == "set-idle-hint") {
+                if (action.args.size() != 1 || (action.args[0] != "true" && action.args[0] != "false"))
+                    return std::unexpected("usage: logind:set-idle-hint <true|false>");
+            } else if (action.verb == "lock-session" || action.verb == "unlock-session" || action.verb == "suspend" || action.verb == "hibernate" ||
+                       action.verb == "suspend-then-hibernate") {
+                if (!action.args.empty())
+                    return std::unexpected(std::format("logind:{} takes no arguments", action.verb));
+            } else
+                return std::unexpected(std::format("unknown logind verb {}", action.verb));
+        } break;
+        case SAction::ACTION_HYPRCTL: {
+            // ; separates the requests of a batch
+            if (command.find(';') != std::string::npos)
+                return std::unexpected("hyprctl: requests can't contain ;");
+        } break;
+        default: break;
+    }
+
+    return action;
+}
+
+const std::vector<CConfigManager::STimeoutRule>& CConfigManager::getRules() const {
     return m_vRules;
 }
 
+std::set<std::string> CConfigManager::configFiles() const {
+    auto files = alreadyIncludedSourceFiles;
+    files.insert(configHeadPath);
+    return files;
+}
+
 std::optional<std::string> CConfigManager::handleSource(const std::string& command, const std::string& rawpath) {
     if (rawpath.length() < 2)
         return "source path " + rawpath + " bogus!";
@@ -4,6 +4,7 @@
 
 #include <hyprlang.hpp>
 
+#include <expected>
 #include <set>
 #include <vector>
 #include <memory>
@@ -12,15 +13,47 @@ class CConfigManager {
   public:
     CConfigManager(std::string configPath);
     void init();
+    // re-parses the config and all source= files. Rules are rebuilt from scratch.
+    bool reload();
 
     struct STimeoutRule {
-        uint64_t    timeout       = 0;
-        std::string onTimeout     = "";
-        std::string onResume      = "";
-        bool        ignoreInhibit = false;
+        uint64_t    timeout        = 0;
+        std::string onTimeout      = "";
+        std::string onResume       = "";
+        bool        ignoreInhibit  = false;
+        uint64_t    deadline       = 0;
+        bool        cancelOnResume = false;
+        uint64_t    minIdleMs      = 0; // on-timeout waits this long after idling, resuming before that runs neither command
+        uint64_t    resumeGraceMs  = 0; // on-resume waits this long, input stopping again within half of it holds it until the next input
+        // commands of this listener wait for those of the listeners named in after, if they were triggered by the same event
+        std::string              id = "";
+        std::vector<std::string> after;
+        // glob matched against the wl_seat name, the rule applies to every seat if empty
+        std::string seat = "";
+
+        bool        operator==(const STimeoutRule&) const = default;
     };
 
-    std::vector<STimeoutRule>  getRules();
+    // Any command (on-timeout, lock_cmd, ...) can be a built-in action run in-process instead: "<type>:<verb> [args]".
+    struct SAction {
+        enum eType : uint8_t {
+            ACTION_COMMAND,   // anything without a known prefix
+            ACTION_BACKLIGHT, // backlight:dim <value> [device], backlight:set <value> [device], backlight:restore [device]
+            ACTION_LOGIND,    // logind:lock-session, unlock-session, suspend, hibernate, suspend-then-hibernate, set-idle-hint <bool>
+            ACTION_HYPRCTL,   // hyprctl:<request>, e.g. hyprctl:dispatch dpms off
+        };
+
+        eType                    type = ACTION_COMMAND;
+        std::string              verb;
+        std::vector<std::string> args;
+    };
+
+    // errors out on a known prefix with a bad verb or bad arguments
+    static std::expected<SAction, std::string> parseAction(const std::string& command);
+
+    const std::vector<STimeoutRule>& getRules() const;
+    // the config and everything it sources, the config as given as well (it might be a symlink)
+    std::set<std::string>            configFiles() const;
     std::optional<std::string> handleSource(const std::string&, const std::string&);
     std::string                configCurrentPath, configHeadPath;
     std::set<std::string>      alreadyIncludedSourceFiles;
@@ -35,6 +68,7 @@ class CConfigManager {
 
     std::vector<STimeoutRule> m_vRules;
 
+    void                      parse();
     Hyprlang::CParseResult    postParse();
 };
 
@@ -0,0 +1,118 @@
+#include "ConfigWatcher.hpp"
+#include "../core/EventLoop.hpp"
+#include "../helpers/Log.hpp"
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+// editors tend to write in several steps, wait for them to settle
+constexpr std::chrono::milliseconds RELOAD_DEBOUNCE = std::chrono::milliseconds{100};
+
+CConfigWatcher::CConfigWatcher() {
+    m_inotifyFd = Hyprutils::OS::CFileDescriptor{inotify_init1(IN_CLOEXEC | IN_NONBLOCK)};
+    if (!m_inotifyFd.isValid()) {
+        Debug::log(ERR, "inotify_init1 failed: {}, config changes won't be picked up automatically", strerror(errno));
+        return;
+    }
+
+    g_pEventLoop->addFd(m_inotifyFd.get(), EPOLLIN, [this](uint32_t) { onInotifyEvent(); });
+}
+
+void CConfigWatcher::setWatchList(const std::set<std::string>& paths) {
+    if (!m_inotifyFd.isValid())
+        return;
+
+    for (const auto& [wd, dirs] : m_watchedDirs) {
+        inotify_rm_watch(m_inotifyFd.get(), wd);
+    }
+
+    m_watchedDirs.clear();
+    m_watchedFiles.clear();
+
+    // with a symlinked config (dotfiles), replacing the link is a change as much as editing its target, so every hop is watched
+    for (const auto& p : paths) {
+        std::error_code       ec;
+        std::filesystem::path path = p;
+
+        for (int hops = 0; hops < 40; ++hops) {
+            m_watchedFiles.insert(path.lexically_normal().string());
+
+            if (!std::filesystem::is_symlink(path, ec))
+                break;
+
+            const auto TARGET = std::filesystem::read_symlink(path, ec);
+            if (ec)
+                break;
+
+            path = TARGET.is_absolute() ? TARGET : path.parent_path() / TARGET;
+        }
+
+        // symlinked directories on the way
+        if (const auto CANONICAL = std::filesystem::weakly_canonical(p, ec); !ec)
+            m_watchedFiles.insert(CANONICAL.string());
+    }
+
+    std::set<std::string> dirs;
+    for (const auto& p : m_watchedFiles) {
+        dirs.insert(std::filesystem::path(p).parent_path().string());
+    }
+
+    for (const auto& dir : dirs) {
+        const int WD = inotify_add_watch(m_inotifyFd.get(), dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (WD < 0) {
+            Debug::log(WARN, "Failed to watch {} for config changes: {}", dir, strerror(errno));
+            continue;
+        }
+
+        // inotify returns the same wd for a directory that is already watched, e.g. through a symlink
+        m_watchedDirs[WD].insert(dir);
+    }
+
+    Debug::log(TRACE, "Watching {} config files in {} directories", m_watchedFiles.size(), m_watchedDirs.size());
+}
+
+void CConfigWatcher::setOnChange(std::function<void()> callback) {
+    m_onChange = std::move(callback);
+}
+
+void CConfigWatcher::onInotifyEvent() {
+    alignas(inotify_event) char buffer[4096];
+    bool                        changed = false;
+
+    while (true) {
+        const ssize_t LEN = read(m_inotifyFd.get(), buffer, sizeof(buffer));
+        if (LEN <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < LEN;) {
+            const auto* EVENT = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + EVENT->len;
+
+            const auto DIR = m_watchedDirs.find(EVENT->wd);
+            if (DIR == m_watchedDirs.end() || EVENT->len == 0)
+                continue;
+
+            for (const auto& dir : DIR->second) {
+                const auto PATH = (std::filesystem::path(dir) / EVENT->name).string();
+                if (m_watchedFiles.contains(PATH)) {
+                    Debug::log(TRACE, "Config file {} changed", PATH);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    if (!changed || !m_onChange)
+        return;
+
+    if (m_debounceTimer)
+        g_pEventLoop->removeTimer(m_debounceTimer);
+
+    m_debounceTimer = g_pEventLoop->addTimer(RELOAD_DEBOUNCE, [this]() {
+        m_debounceTimer = 0;
+        m_onChange();
+    });
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+// Watches the directories of the config files, so that editors replacing the file (write + rename) are picked up as well.
+// Symlinks are followed, the link and its target are both watched.
+class CConfigWatcher {
+  public:
+    CConfigWatcher();
+
+    void setWatchList(const std::set<std::string>& paths);
+    void setOnChange(std::function<void()> callback);
+
+  private:
+    void                                           onInotifyEvent();
+
+    Hyprutils::OS::CFileDescriptor                 m_inotifyFd;
+    std::unordered_map<int, std::set<std::string>> m_watchedDirs; // wd -> dirs, several if symlinked
+    std::set<std::string>                          m_watchedFiles;
+    std::function<void()>                          m_onChange;
+    uint64_t                                       m_debounceTimer = 0;
+};
+
+inline std::unique_ptr<CConfigWatcher> g_pConfigWatcher;
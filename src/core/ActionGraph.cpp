@@ -0,0 +1,132 @@
+#include "ActionGraph.hpp"
+#include "../helpers/Log.hpp"
+#include <algorithm>
+
+CActionGraph::CActionGraph(size_t concurrency) : m_concurrency(concurrency) {
+    ;
+}
+
+void CActionGraph::add(const void* owner, const std::string& id, const std::vector<std::string>& after, const std::string& command, const SSpawnOptions& options,
+                       StartedCallback onStarted) {
+    if (m_started) {
+        Debug::log(ERR, "BUG THIS: adding {} to an action graph that already runs", command);
+        return;
+    }
+
+    m_nodes.emplace_back(SNode{.owner = owner, .id = id, .after = after, .command = command, .options = options, .onStarted = std::move(onStarted)});
+}
+
+void CActionGraph::run() {
+    m_started = true;
+
+    // commands ordered after something that isn't part of this dispatch (or was cancelled already) don't wait for it
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        for (const auto& dep : m_nodes[i].after) {
+            for (size_t j = 0; j < m_nodes.size(); ++j) {
+                if (i == j || m_nodes[j].id != dep || m_nodes[j].state == STATE_DONE)
+                    continue;
+
+                m_nodes[j].dependents.push_back(i);
+                m_nodes[i].waitingOn++;
+            }
+        }
+    }
+
+    if (m_nodes.size() > 1)
+        Debug::log(LOG, "Running {} actions, at most {} at a time", m_nodes.size(), m_concurrency ? std::to_string(m_concurrency) : std::string{"all"});
+
+    pump();
+}
+
+void CActionGraph::cancel(const void* owner) {
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].owner != owner || m_nodes[i].state != STATE_WAITING)
+            continue;
+
+        Debug::log(LOG, "Dropping {}, it didn't start yet", m_nodes[i].command);
+        finish(i);
+    }
+}
+
+bool CActionGraph::done() const {
+    return m_done == m_nodes.size();
+}
+
+size_t CActionGraph::size() const {
+    return m_nodes.size();
+}
+
+void CActionGraph::start(size_t index) {
+    auto& node = m_nodes[index];
+
+    node.state = STATE_RUNNING;
+    m_running++;
+
+    auto options   = node.options;
+    options.onExit = [this, index]() { onNodeDone(index); };
+
+    // with a dry run this already exited by the time spawn returns
+    const auto PROCESS = g_pExecutor->spawn(node.command, options);
+    if (!PROCESS) {
+        onNodeDone(index);
+        return;
+    }
+
+    if (node.onStarted)
+        node.onStarted(PROCESS);
+}
+
+void CActionGraph::onNodeDone(size_t index) {
+    if (m_nodes[index].state != STATE_RUNNING)
+        return;
+
+    m_running--;
+    finish(index);
+}
+
+void CActionGraph::finish(size_t index) {
+    m_nodes[index].state = STATE_DONE;
+    m_done++;
+
+    for (const auto DEP : m_nodes[index].dependents) {
+        // a cycle that got broken up already doesn't wait anymore
+        if (m_nodes[DEP].waitingOn > 0)
+            m_nodes[DEP].waitingOn--;
+    }
+
+    pump();
+}
+
+void CActionGraph::pump() {
+    if (!m_started)
+        return;
+
+    if (m_pumping) {
+        m_repump = true;
+        return;
+    }
+
+    m_pumping = true;
+
+    do {
+        m_repump = false;
+
+        for (size_t i = 0; i < m_nodes.size(); ++i) {
+            if (m_concurrency > 0 && m_running >= m_concurrency)
+                break;
+
+            if (m_nodes[i].state == STATE_WAITING && m_nodes[i].waitingOn == 0)
+                start(i);
+        }
+
+        // nothing running and nothing can start: the rest waits on each other
+        if (m_running == 0 && !done()) {
+            const auto CYCLE = std::ranges::find_if(m_nodes, [](const auto& n) { return n.state == STATE_WAITING; });
+            Debug::log(ERR, "Listener \"after\" keys form a cycle, running {} anyway", CYCLE->command);
+            CYCLE->waitingOn = 0;
+            m_repump         = true;
+        }
+    } while (m_repump);
+
+    m_pumping = false;
+}
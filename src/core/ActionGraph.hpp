@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../defines.hpp"
+#include "Executor.hpp"
+
+// The on-timeout and on-resume commands triggered by one dispatch, run as a dependency graph.
+// A command starts once every command it is ordered after (listener "after" key, matched against "id") has exited, successfully or not.
+// Independent commands run in parallel, up to the concurrency limit. The owner has to keep the graph around until done().
+class CActionGraph {
+  public:
+    using StartedCallback = std::function<void(SP<CExecutor::SProcess> process)>;
+
+    // 0 means no limit besides general:max_processes
+    CActionGraph(size_t concurrency);
+
+    // owner is only used to match cancel(), onStarted gets the process right after spawning it
+    void   add(const void* owner, const std::string& id, const std::vector<std::string>& after, const std::string& command, const SSpawnOptions& options,
+               StartedCallback onStarted);
+    // resolves the ordering and starts whatever has nothing to wait for
+    void   run();
+    // drops commands of owner that didn't start yet, commands ordered after them go ahead as if they had exited
+    void   cancel(const void* owner);
+
+    bool   done() const;
+    size_t size() const;
+
+  private:
+    enum eState {
+        STATE_WAITING,
+        STATE_RUNNING,
+        STATE_DONE,
+    };
+
+    struct SNode {
+        const void*              owner = nullptr;
+        std::string              id;
+        std::vector<std::string> after;
+        std::string              command;
+        SSpawnOptions            options;
+        StartedCallback          onStarted;
+
+        eState                   state     = STATE_WAITING;
+        size_t                   waitingOn = 0;
+        std::vector<size_t>      dependents;
+    };
+
+    void               start(size_t index);
+    void               onNodeDone(size_t index);
+    void               finish(size_t index);
+    void               pump();
+
+    std::vector<SNode> m_nodes;
+    size_t             m_concurrency = 0;
+    size_t             m_running     = 0;
+    size_t             m_done        = 0;
+    bool               m_started     = false;
+
+    // process exits can come in while we're spawning (dry runs, reaping), those just ask for another pass
+    bool m_pumping = false;
+    bool m_repump  = false;
+};
@@ -0,0 +1,187 @@
+#include "Backlight.hpp"
+#include "EventLoop.hpp"
+#include "Hypridle.hpp"
+#include "../helpers/Log.hpp"
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+constexpr std::chrono::milliseconds FADE_STEP = std::chrono::milliseconds{16};
+
+void CBacklight::run(const CConfigManager::SAction& action, std::function<void()> done) {
+    const auto DEVICE = findDevice(action.verb == "restore" ? (action.args.empty() ? "" : action.args[0]) : (action.args.size() > 1 ? action.args[1] : ""));
+    if (!DEVICE) {
+        done();
+        return;
+    }
+
+    const auto CURRENT = readValue(DEVICE->path + "/brightness");
+    const auto MAX     = readValue(DEVICE->path + "/max_brightness");
+    if (!CURRENT || !MAX) {
+        Debug::log(ERR, "Couldn't read the brightness of {}", DEVICE->path);
+        done();
+        return;
+    }
+
+    // an unfinished fade counts as done, that's where the device is headed
+    int64_t current = *CURRENT;
+    if (const auto FADE = m_fades.find(DEVICE->path); FADE != m_fades.end()) {
+        current = FADE->second.to;
+        g_pEventLoop->removeTimer(FADE->second.timer);
+        // from the loop, whatever waited on it might start another action on this device
+        g_pEventLoop->addTimer(std::chrono::milliseconds{0}, std::move(FADE->second.done));
+        m_fades.erase(FADE);
+    }
+
+    int64_t target = current;
+
+    if (action.verb == "restore") {
+        const auto SAVED = m_saved.find(DEVICE->path);
+        if (SAVED == m_saved.end()) {
+            Debug::log(LOG, "Nothing saved for {}, leaving it at {}", DEVICE->name, current);
+            // a fade we just cancelled would otherwise leave it somewhere in between
+            if (current != *CURRENT)
+                write(*DEVICE, current);
+            done();
+            return;
+        }
+
+        target = SAVED->second;
+    } else {
+        const auto& VALUE = action.args[0];
+        target            = VALUE.ends_with('%') ? *MAX * std::stoll(VALUE.substr(0, VALUE.size() - 1)) / 100 : std::stoll(VALUE);
+        target            = std::clamp<int64_t>(target, 0, *MAX);
+
+        if (action.verb == "dim") {
+            m_saved[DEVICE->path] = current;
+
+            // dimming never brightens a screen that's already darker
+            target = std::min(target, current);
+        }
+    }
+
+    Debug::log(LOG, "Backlight {}: {} -> {} (max {})", DEVICE->name, *CURRENT, target, *MAX);
+
+    fadeTo(*DEVICE, *CURRENT, target, std::move(done));
+}
+
+std::optional<CBacklight::SDevice> CBacklight::findDevice(const std::string& pattern) {
+    static const auto SYSFSROOT = g_pConfigManager->getValue<Hyprlang::STRING>("general:sysfs_root");
+
+    std::error_code   ec;
+
+    for (const auto SUBSYSTEM : {"backlight", "leds"}) {
+        const auto               CLASS = std::filesystem::path{*SYSFSROOT} / "class" / SUBSYSTEM;
+
+        std::vector<std::string> names;
+        for (const auto& entry : std::filesystem::directory_iterator{CLASS, ec}) {
+            names.emplace_back(entry.path().filename());
+        }
+
+        // directory order is arbitrary, this keeps the default stable
+        std::ranges::sort(names);
+
+        for (const auto& name : names) {
+            // without a device, the first backlight it is. brightnessctl does the same.
+            if (pattern.empty() ? std::string_view{SUBSYSTEM} == "backlight" : fnmatch(pattern.c_str(), name.c_str(), 0) == 0)
+                return SDevice{.subsystem = SUBSYSTEM, .name = name, .path = CLASS / name};
+        }
+    }
+
+    Debug::log(ERR, "No backlight device {} under {}", pattern.empty() ? std::string{"at all"} : pattern, std::string{*SYSFSROOT});
+    return std::nullopt;
+}
+
+std::optional<int64_t> CBacklight::readValue(const std::string& path) {
+    std::ifstream file(path);
+    int64_t       value = 0;
+
+    if (!(file >> value))
+        return std::nullopt;
+
+    return value;
+}
+
+void CBacklight::write(const SDevice& device, int64_t value) {
+    if (!m_viaLogind.contains(device.path)) {
+        const int FD  = open((device.path + "/brightness").c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        int       err = errno;
+
+        if (FD >= 0) {
+            const auto STR = std::to_string(value);
+            const bool OK  = ::write(FD, STR.data(), STR.size()) == (ssize_t)STR.size();
+            err            = errno;
+            close(FD);
+
+            if (OK)
+                return;
+        }
+
+        if (err != EACCES && err != EPERM && err != EROFS) {
+            Debug::log(ERR, "Failed to set the brightness of {}: {}", device.path, strerror(err));
+            return;
+        }
+
+        // no udev rule giving us access, logind lets the session owner do it
+        Debug::log(LOG, "{} isn't writable ({}), going through logind from now on", device.path, strerror(err));
+        m_viaLogind.insert(device.path);
+    }
+
+    const auto SESSION = g_pHypridle->getLoginSession();
+    if (!SESSION) {
+        Debug::log(ERR, "Can't set the brightness of {}, logind is not available", device.name);
+        return;
+    }
+
+    try {
+        SESSION->callMethodAsync("SetBrightness")
+            .onInterface("org.freedesktop.login1.Session")
+            .withArguments(device.subsystem, device.name, (uint32_t)value)
+            .uponReplyInvoke([NAME = device.name](std::optional<sdbus::Error> error) {
+                if (error)
+                    Debug::log(ERR, "logind SetBrightness for {} failed: {}", NAME, error->what());
+            });
+    } catch (const std::exception& e) { Debug::log(ERR, "logind SetBrightness for {} failed: {}", device.name, e.what()); }
+}
+
+void CBacklight::fadeTo(const SDevice& device, int64_t from, int64_t to, std::function<void()> done) {
+    static const auto FADEMS = g_pConfigManager->getValue<Hyprlang::INT>("general:backlight_fade_ms");
+
+    if (*FADEMS <= 0 || from == to) {
+        if (from != to)
+            write(device, to);
+        done();
+        return;
+    }
+
+    auto& fade    = m_fades[device.path];
+    fade.from     = from;
+    fade.to       = to;
+    fade.start    = std::chrono::steady_clock::now();
+    fade.duration = std::chrono::milliseconds(*FADEMS);
+    fade.done     = std::move(done);
+
+    fadeStep(device);
+}
+
+void CBacklight::fadeStep(const SDevice& device) {
+    auto&        fade = m_fades[device.path];
+
+    const double PROGRESS = std::min(1.0, std::chrono::duration<double>(std::chrono::steady_clock::now() - fade.start) / fade.duration);
+    write(device, fade.from + (int64_t)((fade.to - fade.from) * PROGRESS));
+
+    if (PROGRESS >= 1.0) {
+        auto done = std::move(fade.done);
+        m_fades.erase(device.path);
+        done();
+        return;
+    }
+
+    fade.timer = g_pEventLoop->addTimer(FADE_STEP, [this, device]() { fadeStep(device); });
+}
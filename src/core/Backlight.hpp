@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../config/ConfigManager.hpp"
+
+// backlight: actions. Brightness of /sys/class/backlight and /sys/class/leds devices is written directly,
+// through logind's Session.SetBrightness if we aren't allowed to. general:sysfs_root moves /sys, e.g. to a fake tree.
+class CBacklight {
+  public:
+    // done is called once the brightness is set, at the end of the fade with general:backlight_fade_ms
+    void run(const CConfigManager::SAction& action, std::function<void()> done);
+
+  private:
+    struct SDevice {
+        std::string subsystem; // backlight or leds
+        std::string name;
+        std::string path;
+    };
+
+    struct SFade {
+        uint64_t                              timer = 0;
+        int64_t                               from  = 0;
+        int64_t                               to    = 0;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::milliseconds             duration;
+        std::function<void()>                 done;
+    };
+
+    std::optional<SDevice>                   findDevice(const std::string& pattern);
+    std::optional<int64_t>                   readValue(const std::string& path);
+    void                                     write(const SDevice& device, int64_t value);
+    void                                     fadeTo(const SDevice& device, int64_t from, int64_t to, std::function<void()> done);
+    void                                     fadeStep(const SDevice& device);
+
+    std::unordered_map<std::string, int64_t> m_saved; // by device path
+    std::unordered_map<std::string, SFade>   m_fades; // by device path
+    std::unordered_set<std::string>          m_viaLogind;
+};
+
+inline std::unique_ptr<CBacklight> g_pBacklight;
@@ -0,0 +1,288 @@
+#include "ControlSocket.hpp"
+#include "EventLoop.hpp"
+#include "Hypridle.hpp"
+#include "../helpers/Log.hpp"
+#include "../helpers/MiscFunctions.hpp"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+
+// nothing we support needs more, anything longer is garbage
+constexpr size_t MAX_REQUEST_LENGTH = 4096;
+// hypridlectl opens one connection per command, more at once is someone misbehaving
+constexpr size_t MAX_CLIENTS = 16;
+// and sends its request right away
+constexpr std::chrono::seconds CLIENT_TIMEOUT = std::chrono::seconds{5};
+// longer inhibits are clamped, which also keeps the timer arithmetic from overflowing
+constexpr uint64_t MAX_INHIBIT_TTL = 7 * 24 * 3600;
+
+static std::string_view nextWord(std::string_view& str) {
+    const auto START = str.find_first_not_of(' ');
+    if (START == std::string_view::npos) {
+        str = {};
+        return {};
+    }
+
+    str.remove_prefix(START);
+
+    const auto END  = str.find(' ');
+    const auto WORD = str.substr(0, END);
+    str.remove_prefix(END == std::string_view::npos ? str.size() : END);
+
+    return WORD;
+}
+
+static bool parseNumber(std::string_view str, uint64_t& out) {
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+    return ec == std::errc{} && ptr == str.data() + str.size();
+}
+
+CControlSocket::CControlSocket() : m_path(controlSocketPath()) {
+    if (m_path.empty()) {
+        Debug::log(ERR, "XDG_RUNTIME_DIR isn't set, not starting the control socket. Set HYPRIDLE_SOCKET to give it a path.");
+        return;
+    }
+
+    // fixed from here on, hypridlectl run from our commands finds us whatever WAYLAND_DISPLAY they were given
+    setenv("HYPRIDLE_SOCKET", m_path.c_str(), 1);
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (m_path.size() >= sizeof(addr.sun_path)) {
+        Debug::log(ERR, "Control socket path {} is too long, hypridlectl won't work", m_path);
+        return;
+    }
+
+    strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // a socket that still accepts connections belongs to another instance, anything else is left over from a crash
+    if (Hyprutils::OS::CFileDescriptor probe{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)}; probe.isValid()) {
+        if (connect(probe.get(), (sockaddr*)&addr, sizeof(addr)) == 0) {
+            Debug::log(ERR, "Another hypridle is already listening on {}, hypridlectl will talk to that one", m_path);
+            m_path.clear();
+            return;
+        }
+    }
+
+    unlink(m_path.c_str());
+
+    // owner only before anyone can connect, connections are refused until listen()
+    m_socket = Hyprutils::OS::CFileDescriptor{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)};
+    if (!m_socket.isValid() || bind(m_socket.get(), (sockaddr*)&addr, sizeof(addr)) < 0 || chmod(m_path.c_str(), S_IRUSR | S_IWUSR) < 0 ||
+        listen(m_socket.get(), 16) < 0) {
+        Debug::log(ERR, "Failed to set up the control socket at {}: {}", m_path, strerror(errno));
+        if (m_socket.isValid())
+            unlink(m_path.c_str());
+        m_socket.reset();
+        m_path.clear();
+        return;
+    }
+
+    g_pEventLoop->addFd(m_socket.get(), EPOLLIN, [this](uint32_t) { onAccept(); });
+
+    Debug::log(LOG, "Control socket listening on {}", m_path);
+}
+
+CControlSocket::~CControlSocket() {
+    if (!m_path.empty())
+        unlink(m_path.c_str());
+}
+
+void CControlSocket::onAccept() {
+    while (true) {
+        Hyprutils::OS::CFileDescriptor fd{accept4(m_socket.get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)};
+        if (!fd.isValid()) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                Debug::log(ERR, "Control socket accept failed: {}", strerror(errno));
+            return;
+        }
+
+        // the socket is 0600 already, this also covers a HYPRIDLE_SOCKET in a directory others can get into
+        ucred     cred    = {};
+        socklen_t credLen = sizeof(cred);
+        if (getsockopt(fd.get(), SOL_SOCKET, SO_PEERCRED, &cred, &credLen) < 0 || cred.uid != getuid()) {
+            Debug::log(WARN, "Refusing a control socket connection from uid {} (pid {})", cred.uid, cred.pid);
+            continue;
+        }
+
+        if (m_clients.size() >= MAX_CLIENTS) {
+            Debug::log(WARN, "{} control socket clients are connected already, refusing another", m_clients.size());
+            continue;
+        }
+
+        const int FD     = fd.get();
+        auto      client = makeShared<SClient>();
+        client->fd       = std::move(fd);
+        client->timer    = g_pEventLoop->addTimer(CLIENT_TIMEOUT, [this, FD]() {
+            Debug::log(LOG, "Control socket client didn't send a request within {}s, closing it", CLIENT_TIMEOUT.count());
+            m_clients[FD]->timer = 0;
+            closeClient(FD);
+        });
+
+        m_clients[FD] = client;
+        g_pEventLoop->addFd(FD, EPOLLIN, [this, FD](uint32_t) { onClientData(FD); });
+    }
+}
+
+void CControlSocket::onClientData(int fd) {
+    const auto IT = m_clients.find(fd);
+    if (IT == m_clients.end())
+        return;
+
+    auto&   client = IT->second;
+    char    buf[512];
+    ssize_t len = 0;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        client->request.append(buf, len);
+    }
+
+    const bool EOFREACHED = len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    const auto NEWLINE    = client->request.find('\n');
+
+    if (NEWLINE == std::string::npos && !EOFREACHED) {
+        if (client->request.size() > MAX_REQUEST_LENGTH)
+            closeClient(fd);
+        return;
+    }
+
+    const auto REPLY = handleRequest(client->request.substr(0, NEWLINE));
+
+    // replies are small, the socket buffer takes them whole
+    if (send(fd, REPLY.data(), REPLY.size(), MSG_NOSIGNAL) < 0)
+        Debug::log(WARN, "Failed to reply on the control socket: {}", strerror(errno));
+
+    closeClient(fd);
+}
+
+void CControlSocket::closeClient(int fd) {
+    const auto IT = m_clients.find(fd);
+    if (IT == m_clients.end())
+        return;
+
+    if (IT->second->timer)
+        g_pEventLoop->removeTimer(IT->second->timer);
+
+    g_pEventLoop->removeFd(fd);
+    m_clients.erase(IT);
+}
+
+std::string CControlSocket::handleRequest(const std::string& request) {
+    std::string_view args    = request;
+    const auto       COMMAND = nextWord(args);
+
+    Debug::log(TRACE, "Control socket request: {}", request);
+
+    if (COMMAND == "status")
+        return status();
+
+    if (COMMAND == "idle")
+        return g_pHypridle->isIdle() ? "yes\n" : "no\n";
+
+    if (COMMAND == "inhibit")
+        return addInhibit(std::string{args});
+
+    if (COMMAND == "uninhibit") {
+        uint64_t id = 0;
+        if (!parseNumber(nextWord(args), id))
+            return "error: usage: uninhibit <id>\n";
+
+        return removeInhibit(id);
+    }
+
+    if (COMMAND == "fire" || COMMAND == "reset") {
+        uint64_t index = 0;
+        if (!parseNumber(nextWord(args), index))
+            return std::format("error: usage: {} <listener index>\n", COMMAND);
+
+        const bool OK = COMMAND == "fire" ? g_pHypridle->fireListener(index) : g_pHypridle->resetListener(index);
+        return OK ? "ok\n" : std::format("error: no listener {}\n", index);
+    }
+
+    if (COMMAND == "reload") {
+        g_pHypridle->reloadConfig();
+        return "ok\n";
+    }
+
+    return std::format("error: unknown command \"{}\"\n", COMMAND);
+}
+
+std::string CControlSocket::status() {
+    std::string out;
+
+    out += std::format("idle: {}\n", g_pHypridle->isIdle());
+    out += std::format("locked: {}\n", g_pHypridle->isLocked());
+    out += std::format("inhibit locks: {}\n", g_pHypridle->inhibitLocks());
+    out += std::format("screensaver cookies: {}\n", g_pHypridle->getDbusInhibitCookies().size());
+    out += std::format("sleep inhibitor: {}\n", g_pHypridle->sleepInhibitActive());
+
+    const auto NOW = std::chrono::steady_clock::now();
+    for (const auto& [id, inhibit] : m_inhibits) {
+        out += std::format("inhibit {}: {}s left, {}\n", id, std::chrono::duration_cast<std::chrono::seconds>(inhibit.expires - NOW).count(), inhibit.reason);
+    }
+
+    const auto SEATNAME = [](const auto& seat) { return !seat || seat->name.empty() ? std::string{"(unnamed)"} : seat->name; };
+
+    for (const auto& seat : g_pHypridle->getSeats()) {
+        out += std::format("seat {}: idle {}, {} listeners\n", SEATNAME(seat), seat->idled, seat->listeners.size());
+    }
+
+    const auto& LISTENERS = g_pHypridle->getListeners();
+    for (size_t i = 0; i < LISTENERS.size(); ++i) {
+        const auto& l = LISTENERS[i];
+        out += std::format("listener {}: seat {}, timeout {}s, fired {}, idled {}, resumed {}\n", i, SEATNAME(l->seat.lock()), l->rule.timeout, l->onTimeoutFired,
+                           l->idledCount, l->resumedCount);
+    }
+
+    return out;
+}
+
+std::string CControlSocket::addInhibit(const std::string& args) {
+    std::string_view rest = args;
+    uint64_t         ttl  = 0;
+
+    if (!parseNumber(nextWord(rest), ttl) || ttl == 0)
+        return "error: usage: inhibit <seconds> [reason]\n";
+
+    if (ttl > MAX_INHIBIT_TTL) {
+        Debug::log(LOG, "Control socket inhibit of {}s clamped to {}s", ttl, MAX_INHIBIT_TTL);
+        ttl = MAX_INHIBIT_TTL;
+    }
+
+    const auto START = rest.find_first_not_of(' ');
+    const auto ID    = m_nextInhibitID++;
+
+    auto&      inhibit = m_inhibits[ID];
+    inhibit.reason     = START == std::string_view::npos ? "hypridlectl" : std::string{rest.substr(START)};
+    inhibit.expires    = std::chrono::steady_clock::now() + std::chrono::seconds(ttl);
+    inhibit.timer      = g_pEventLoop->addTimer(std::chrono::seconds(ttl), [this, ID]() {
+        Debug::log(LOG, "Control socket inhibit {} expired", ID);
+        m_inhibits[ID].timer = 0;
+        removeInhibit(ID);
+    });
+
+    Debug::log(LOG, "Control socket inhibit {} for {}s: {}", ID, ttl, inhibit.reason);
+    g_pHypridle->onInhibit(true);
+
+    return std::format("{}\n", ID);
+}
+
+std::string CControlSocket::removeInhibit(uint64_t id) {
+    const auto IT = m_inhibits.find(id);
+    if (IT == m_inhibits.end())
+        return std::format("error: no inhibit {}\n", id);
+
+    if (IT->second.timer)
+        g_pEventLoop->removeTimer(IT->second.timer);
+
+    m_inhibits.erase(IT);
+    g_pHypridle->onInhibit(false);
+
+    return "ok\n";
+}
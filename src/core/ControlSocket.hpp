@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+#include "../defines.hpp"
+
+// Unix socket for hypridlectl, served from the event loop.
+// One request per connection: a single line with the command and its arguments, the reply is written back and the connection closed.
+// Only the user we run as may connect.
+class CControlSocket {
+  public:
+    CControlSocket();
+    ~CControlSocket();
+
+  private:
+    struct SClient {
+        Hyprutils::OS::CFileDescriptor fd;
+        std::string                    request;
+        uint64_t                       timer = 0;
+    };
+
+    struct SInhibit {
+        std::string                           reason;
+        uint64_t                              timer = 0;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    void                                   onAccept();
+    void                                   onClientData(int fd);
+    void                                   closeClient(int fd);
+
+    std::string                            handleRequest(const std::string& request);
+    std::string                            status();
+    std::string                            addInhibit(const std::string& args);
+    std::string                            removeInhibit(uint64_t id);
+
+    std::string                            m_path;
+    Hyprutils::OS::CFileDescriptor         m_socket;
+    std::unordered_map<int, SP<SClient>>   m_clients;
+    std::unordered_map<uint64_t, SInhibit> m_inhibits;
+    uint64_t                               m_nextInhibitID = 1;
+};
+
+inline std::unique_ptr<CControlSocket> g_pControlSocket;
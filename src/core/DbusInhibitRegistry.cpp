@@ -0,0 +1,93 @@
+#include "DbusInhibitRegistry.hpp"
+#include <algorithm>
+
+void CDbusInhibitRegistry::add(uint32_t cookie, const std::string& app, const std::string& reason, const std::string& ownerID) {
+    if (m_cookies.contains(cookie))
+        remove(cookie);
+
+    const auto OWNER = m_byOwner.try_emplace(ownerID).first;
+    OWNER->second.insert(cookie);
+
+    SCookie c = {
+        .cookie  = cookie,
+        .app     = intern(app),
+        .reason  = intern(reason),
+        .ownerID = &OWNER->first,
+    };
+
+    m_appCounts[c.app]++;
+    m_cookies[cookie] = c;
+}
+
+const CDbusInhibitRegistry::SCookie* CDbusInhibitRegistry::get(uint32_t cookie) const {
+    const auto IT = m_cookies.find(cookie);
+    return IT == m_cookies.end() ? nullptr : &IT->second;
+}
+
+bool CDbusInhibitRegistry::remove(uint32_t cookie) {
+    const auto IT = m_cookies.find(cookie);
+    if (IT == m_cookies.end())
+        return false;
+
+    const auto COOKIE = IT->second;
+    m_cookies.erase(IT);
+
+    if (auto owner = m_byOwner.find(*COOKIE.ownerID); owner != m_byOwner.end()) {
+        owner->second.erase(cookie);
+        if (owner->second.empty())
+            m_byOwner.erase(owner);
+    }
+
+    if (auto count = m_appCounts.find(COOKIE.app); count != m_appCounts.end() && --count->second == 0)
+        m_appCounts.erase(count);
+
+    release(COOKIE.app);
+    release(COOKIE.reason);
+
+    return true;
+}
+
+size_t CDbusInhibitRegistry::removeOwner(const std::string& ownerID) {
+    const auto OWNER = m_byOwner.find(ownerID);
+    if (OWNER == m_byOwner.end())
+        return 0;
+
+    // remove() erases the owner entry together with its last cookie
+    const auto COOKIES = OWNER->second;
+    for (const auto C : COOKIES) {
+        remove(C);
+    }
+
+    return COOKIES.size();
+}
+
+size_t CDbusInhibitRegistry::size() const {
+    return m_cookies.size();
+}
+
+std::vector<std::pair<std::string, size_t>> CDbusInhibitRegistry::countsPerApp() const {
+    std::vector<std::pair<std::string, size_t>> counts;
+    counts.reserve(m_appCounts.size());
+
+    for (const auto& [app, count] : m_appCounts) {
+        counts.emplace_back(*app, count);
+    }
+
+    std::ranges::sort(counts);
+    return counts;
+}
+
+const std::string* CDbusInhibitRegistry::intern(const std::string& str) {
+    auto [it, inserted] = m_strings.try_emplace(str, 0);
+    it->second++;
+    return &it->first;
+}
+
+void CDbusInhibitRegistry::release(const std::string* str) {
+    const auto IT = m_strings.find(*str);
+    if (IT == m_strings.end())
+        return;
+
+    if (--IT->second == 0)
+        m_strings.erase(IT);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// ScreenSaver inhibit cookies, indexed by cookie and by the bus name owning them.
+// App names and reasons are interned, a browser with many tabs tends to send the same ones over and over.
+class CDbusInhibitRegistry {
+  public:
+    struct SCookie {
+        uint32_t           cookie  = 0;
+        const std::string* app     = nullptr;
+        const std::string* reason  = nullptr;
+        const std::string* ownerID = nullptr;
+    };
+
+    void                                        add(uint32_t cookie, const std::string& app, const std::string& reason, const std::string& ownerID);
+    const SCookie*                              get(uint32_t cookie) const;
+    bool                                        remove(uint32_t cookie);
+    // returns the number of cookies removed
+    size_t                                      removeOwner(const std::string& ownerID);
+
+    size_t                                      size() const;
+    std::vector<std::pair<std::string, size_t>> countsPerApp() const;
+
+  private:
+    const std::string*                                            intern(const std::string& str);
+    void                                                          release(const std::string* str);
+
+    std::unordered_map<uint32_t, SCookie>                         m_cookies;
+    std::unordered_map<std::string, std::unordered_set<uint32_t>> m_byOwner; // a browser holds lots of them, UnInhibit is O(1)
+    std::unordered_map<std::string, size_t>                       m_strings; // refcounted
+    std::unordered_map<const std::string*, size_t>                m_appCounts;
+};
@@ -0,0 +1,254 @@
+#include "EventLoop.hpp"
+#include "EventRecorder.hpp"
+#include "Tracer.hpp"
+#include "../helpers/Log.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <atomic>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+static std::atomic<uint32_t> pendingSignals = 0;
+static int                   signalEventFd  = -1;
+
+static void                  onSignal(int sig) {
+    const int SAVEDERRNO = errno;
+
+    pendingSignals.fetch_or(1u << sig);
+
+    uint64_t one = 1;
+    if (write(signalEventFd, &one, sizeof(one)) < 0) {
+        ; // nothing we can do about it in a signal handler
+    }
+
+    errno = SAVEDERRNO;
+}
+
+CEventLoop::CEventLoop() {
+    m_epollFd = Hyprutils::OS::CFileDescriptor{epoll_create1(EPOLL_CLOEXEC)};
+    RASSERT(m_epollFd.isValid(), "[core] epoll_create1 failed: {}", strerror(errno));
+
+    m_signalEventFd = Hyprutils::OS::CFileDescriptor{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+    RASSERT(m_signalEventFd.isValid(), "[core] eventfd failed: {}", strerror(errno));
+
+    signalEventFd = m_signalEventFd.get();
+
+    addFd(m_signalEventFd.get(), EPOLLIN, [this](uint32_t) { dispatchSignals(); });
+
+    m_timerFd = Hyprutils::OS::CFileDescriptor{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)};
+    RASSERT(m_timerFd.isValid(), "[core] timerfd_create failed: {}", strerror(errno));
+
+    addFd(m_timerFd.get(), EPOLLIN, [this](uint32_t) { dispatchTimers(); });
+}
+
+bool CEventLoop::addFd(int fd, uint32_t events, FdCallback callback) {
+    if (m_fdToSource.contains(fd)) {
+        Debug::log(ERR, "[core] fd {} is already registered in the event loop", fd);
+        return false;
+    }
+
+    const auto  ID = m_nextSourceID++;
+
+    epoll_event ev = {
+        .events = events,
+        .data   = {.u64 = ID},
+    };
+
+    if (epoll_ctl(m_epollFd.get(), EPOLL_CTL_ADD, fd, &ev) < 0) {
+        Debug::log(ERR, "[core] Failed to add fd {} to epoll: {}", fd, strerror(errno));
+        return false;
+    }
+
+    m_sources[ID]    = makeShared<SSource>(SSource{.fd = fd, .callback = std::move(callback)});
+    m_fdToSource[fd] = ID;
+    return true;
+}
+
+bool CEventLoop::modifyFd(int fd, uint32_t events) {
+    const auto IT = m_fdToSource.find(fd);
+    if (IT == m_fdToSource.end())
+        return false;
+
+    epoll_event ev = {
+        .events = events,
+        .data   = {.u64 = IT->second},
+    };
+
+    if (epoll_ctl(m_epollFd.get(), EPOLL_CTL_MOD, fd, &ev) < 0) {
+        Debug::log(ERR, "[core] Failed to modify fd {} in epoll: {}", fd, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void CEventLoop::removeFd(int fd) {
+    const auto IT = m_fdToSource.find(fd);
+    if (IT == m_fdToSource.end())
+        return;
+
+    // the fd might already be closed, in which case the kernel dropped it for us
+    epoll_ctl(m_epollFd.get(), EPOLL_CTL_DEL, fd, nullptr);
+
+    m_sources.erase(IT->second);
+    m_fdToSource.erase(IT);
+}
+
+uint64_t CEventLoop::addTimer(std::chrono::milliseconds timeout, TimerCallback callback) {
+    const auto ID = m_nextTimerID++;
+    const auto IT = m_timerQueue.emplace(std::chrono::steady_clock::now() + timeout, ID);
+
+    m_timers[ID] = STimer{.it = IT, .callback = std::move(callback)};
+
+    if (IT == m_timerQueue.begin())
+        rearmTimerFd();
+
+    return ID;
+}
+
+void CEventLoop::removeTimer(uint64_t id) {
+    const auto IT = m_timers.find(id);
+    if (IT == m_timers.end())
+        return;
+
+    const bool WASFIRST = IT->second.it == m_timerQueue.begin();
+
+    m_timerQueue.erase(IT->second.it);
+    m_timers.erase(IT);
+
+    if (WASFIRST)
+        rearmTimerFd();
+}
+
+void CEventLoop::rearmTimerFd() {
+    itimerspec spec = {};
+
+    if (!m_timerQueue.empty()) {
+        // steady_clock is CLOCK_MONOTONIC on linux
+        const auto NS         = std::chrono::duration_cast<std::chrono::nanoseconds>(m_timerQueue.begin()->first.time_since_epoch()).count();
+        spec.it_value.tv_sec  = NS / 1000000000;
+        spec.it_value.tv_nsec = NS % 1000000000;
+
+        // a zero it_value would disarm it
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(m_timerFd.get(), TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void CEventLoop::dispatchTimers() {
+    TRACE_SPAN("timers", "dispatch");
+
+    uint64_t expirations = 0;
+    if (read(m_timerFd.get(), &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        Debug::log(ERR, "[core] Failed to read the timerfd: {}", strerror(errno));
+
+    const auto NOW = std::chrono::steady_clock::now();
+
+    // collect first, callbacks are free to add or remove timers
+    std::vector<uint64_t> expired;
+    for (auto it = m_timerQueue.begin(); it != m_timerQueue.end() && it->first <= NOW; ++it) {
+        expired.push_back(it->second);
+    }
+
+    for (const auto ID : expired) {
+        const auto IT = m_timers.find(ID);
+        if (IT == m_timers.end())
+            continue;
+
+        auto callback = std::move(IT->second.callback);
+        m_timerQueue.erase(IT->second.it);
+        m_timers.erase(IT);
+
+        callback();
+    }
+
+    rearmTimerFd();
+}
+
+void CEventLoop::addPreWaitHook(std::function<void()> hook) {
+    m_preWaitHooks.emplace_back(std::move(hook));
+}
+
+void CEventLoop::setSignalHandler(SignalCallback callback) {
+    m_signalCallback = std::move(callback);
+
+    struct sigaction sa = {};
+    sa.sa_handler       = ::onSignal;
+    sa.sa_flags         = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+
+    for (const int SIG : {SIGTERM, SIGINT, SIGHUP, SIGUSR1}) {
+        sigaction(SIG, &sa, nullptr);
+    }
+}
+
+void CEventLoop::dispatchSignals() {
+    TRACE_SPAN("signals", "dispatch");
+
+    uint64_t count = 0;
+    while (read(m_signalEventFd.get(), &count, sizeof(count)) > 0) {
+        ;
+    }
+
+    const auto PENDING = pendingSignals.exchange(0);
+    for (int sig = 1; sig < 32; ++sig) {
+        if (!(PENDING & (1u << sig)))
+            continue;
+
+        Debug::log(LOG, "[core] Received signal {} ({})", sig, strsignal(sig));
+
+        if (m_signalCallback)
+            m_signalCallback(sig);
+        else
+            terminate();
+    }
+}
+
+void CEventLoop::terminate() {
+    m_bTerminate = true;
+}
+
+void CEventLoop::enter() {
+    constexpr int MAXEVENTS = 16;
+    epoll_event   events[MAXEVENTS];
+
+    while (!m_bTerminate) {
+        for (auto& hook : m_preWaitHooks) {
+            hook();
+        }
+
+        // logs and recordings are only written out when there is nothing else to do
+        Debug::flush();
+        if (g_pEventRecorder)
+            g_pEventRecorder->flush();
+
+        // no timeout. Everything that needs to wake us up has an fd.
+        const int NFDS = epoll_wait(m_epollFd.get(), events, MAXEVENTS, -1);
+        if (NFDS < 0) {
+            if (errno == EINTR)
+                continue;
+
+            Debug::log(CRIT, "[core] epoll_wait failed with {}", errno);
+            exit(1);
+        }
+
+        for (int i = 0; i < NFDS; ++i) {
+            // sources may get removed by earlier callbacks in this batch
+            const auto IT = m_sources.find(events[i].data.u64);
+            if (IT == m_sources.end())
+                continue;
+
+            // keep the source alive in case the callback removes itself
+            const auto SOURCE = IT->second;
+            SOURCE->callback(events[i].events);
+
+            if (m_bTerminate)
+                break;
+        }
+    }
+}
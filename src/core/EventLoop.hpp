@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+#include "../defines.hpp"
+
+class CEventLoop {
+  public:
+    CEventLoop();
+
+    using FdCallback     = std::function<void(uint32_t events)>;
+    using SignalCallback = std::function<void(int sig)>;
+    using TimerCallback  = std::function<void()>;
+
+    // level-triggered, events are EPOLL* flags
+    bool addFd(int fd, uint32_t events, FdCallback callback);
+    // changes the events a registered fd is watched for
+    bool modifyFd(int fd, uint32_t events);
+    void removeFd(int fd);
+
+    // one-shot, returns an id for removeTimer. All timers share a single timerfd armed for the earliest deadline.
+    uint64_t addTimer(std::chrono::milliseconds timeout, TimerCallback callback);
+    void     removeTimer(uint64_t id);
+
+    // called right before every blocking wait, e.g. to flush outgoing buffers
+    void addPreWaitHook(std::function<void()> hook);
+
+    // SIGTERM, SIGINT, SIGHUP and SIGUSR1 are delivered through the loop instead of interrupting it
+    void setSignalHandler(SignalCallback callback);
+
+    void enter();
+    void terminate();
+
+  private:
+    struct SSource {
+        int        fd = -1;
+        FdCallback callback;
+    };
+
+    using TimerQueue = std::multimap<std::chrono::steady_clock::time_point, uint64_t>;
+
+    struct STimer {
+        TimerQueue::iterator it;
+        TimerCallback        callback;
+    };
+
+    void                                      dispatchSignals();
+    void                                      dispatchTimers();
+    void                                      rearmTimerFd();
+
+    Hyprutils::OS::CFileDescriptor            m_epollFd;
+    Hyprutils::OS::CFileDescriptor            m_signalEventFd;
+    Hyprutils::OS::CFileDescriptor            m_timerFd;
+
+    std::unordered_map<uint64_t, SP<SSource>> m_sources;
+    std::unordered_map<int, uint64_t>         m_fdToSource;
+    uint64_t                                  m_nextSourceID = 1;
+
+    TimerQueue                                m_timerQueue;
+    std::unordered_map<uint64_t, STimer>      m_timers;
+    uint64_t                                  m_nextTimerID = 1;
+
+    std::vector<std::function<void()>>        m_preWaitHooks;
+    SignalCallback                            m_signalCallback;
+
+    bool                                      m_bTerminate = false;
+};
+
+inline std::unique_ptr<CEventLoop> g_pEventLoop;
@@ -0,0 +1,199 @@
+#include "EventRecorder.hpp"
+#include "../helpers/Log.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+
+constexpr std::string_view MAGIC   = "HYPRIDLEREC";
+constexpr uint8_t          VERSION = 2; // 2: idled/resumed carry the seat name
+// version 1 has the same layout, its idled/resumed just have no strings
+constexpr uint8_t MIN_VERSION = 1;
+// past this much unflushed data we write right away instead of waiting for the loop
+constexpr size_t MAX_PENDING_BYTES = 16 * 1024;
+
+static void                writeVarint(std::string& out, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value)
+            byte |= 0x80;
+        out += (char)byte;
+    } while (value);
+}
+
+static bool readVarint(std::string_view& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in.empty())
+            return false;
+
+        const uint8_t BYTE = in.front();
+        in.remove_prefix(1);
+
+        value |= (uint64_t)(BYTE & 0x7F) << shift;
+        if (!(BYTE & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t RET = write(fd, data, len);
+        if (RET < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        data += RET;
+        len -= RET;
+    }
+
+    return true;
+}
+
+// runs from the crash handler, so no allocations
+static void flushOnCrash() {
+    if (g_pEventRecorder)
+        g_pEventRecorder->flush();
+}
+
+CEventRecorder::CEventRecorder(const std::string& path) :
+    m_fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)), m_start(std::chrono::steady_clock::now()) {
+    if (!m_fd.isValid()) {
+        Debug::log(ERR, "Couldn't open {} for recording", path);
+        return;
+    }
+
+    m_pending = MAGIC;
+    m_pending += (char)VERSION;
+    flush();
+
+    Debug::setCrashHook(::flushOnCrash);
+}
+
+CEventRecorder::~CEventRecorder() {
+    Debug::setCrashHook(nullptr);
+    flush();
+}
+
+bool CEventRecorder::good() const {
+    return m_fd.isValid();
+}
+
+void CEventRecorder::flush() {
+    if (m_pending.empty() || !m_fd.isValid())
+        return;
+
+    if (!writeAll(m_fd.get(), m_pending.data(), m_pending.size()))
+        m_fd.reset();
+
+    m_pending.clear();
+}
+
+void CEventRecorder::record(eEventType type, uint64_t value, uint64_t arg, std::initializer_list<std::string_view> strings) {
+    if (!m_fd.isValid())
+        return;
+
+    const uint64_t NOW = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+
+    std::string    buf;
+    buf += (char)type;
+    writeVarint(buf, NOW - m_lastUs);
+    writeVarint(buf, value);
+    writeVarint(buf, arg);
+    buf += (char)strings.size();
+    for (const auto& s : strings) {
+        writeVarint(buf, s.size());
+        buf += s;
+    }
+
+    m_lastUs = NOW;
+
+    m_pending += buf;
+    if (m_pending.size() > MAX_PENDING_BYTES)
+        flush();
+}
+
+std::optional<std::vector<CEventRecorder::SEvent>> CEventRecorder::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) {
+        Debug::log(ERR, "Couldn't open {}", path);
+        return std::nullopt;
+    }
+
+    const std::string DATA{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    std::string_view  in = DATA;
+
+    if (!in.starts_with(MAGIC) || in.size() < MAGIC.size() + 1 || (uint8_t)in[MAGIC.size()] < MIN_VERSION ||
+        (uint8_t)in[MAGIC.size()] > VERSION) {
+        Debug::log(ERR, "{} is not a hypridle recording (or from an incompatible version)", path);
+        return std::nullopt;
+    }
+
+    in.remove_prefix(MAGIC.size() + 1);
+
+    std::vector<SEvent> events;
+    uint64_t            time = 0;
+
+    while (!in.empty()) {
+        SEvent   ev;
+        uint64_t delta = 0, count = 0;
+
+        ev.type = (eEventType)in.front();
+        in.remove_prefix(1);
+
+        if (!readVarint(in, delta) || !readVarint(in, ev.value) || !readVarint(in, ev.arg) || in.empty()) {
+            Debug::log(WARN, "{} is truncated after {} events", path, events.size());
+            break;
+        }
+
+        count = (uint8_t)in.front();
+        in.remove_prefix(1);
+
+        bool truncated = false;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t len = 0;
+            if (!readVarint(in, len) || len > in.size()) {
+                truncated = true;
+                break;
+            }
+
+            ev.strings.emplace_back(in.substr(0, len));
+            in.remove_prefix(len);
+        }
+
+        if (truncated) {
+            Debug::log(WARN, "{} is truncated after {} events", path, events.size());
+            break;
+        }
+
+        time += delta;
+        ev.timeUs = time;
+        events.emplace_back(std::move(ev));
+    }
+
+    return events;
+}
+
+const char* CEventRecorder::typeName(eEventType type) {
+    switch (type) {
+        case EVENT_START: return "start";
+        case EVENT_IDLED: return "idled";
+        case EVENT_RESUMED: return "resumed";
+        case EVENT_LOCKED: return "locked";
+        case EVENT_UNLOCKED: return "unlocked";
+        case EVENT_SCREENSAVER_INHIBIT: return "ScreenSaver.Inhibit";
+        case EVENT_SCREENSAVER_UNINHIBIT: return "ScreenSaver.UnInhibit";
+        case EVENT_OWNER_LOST: return "owner lost";
+        case EVENT_BLOCK_INHIBITED: return "BlockInhibited";
+        case EVENT_PREPARE_FOR_SLEEP: return "PrepareForSleep";
+        case EVENT_SESSION_LOCK: return "Session.Lock";
+        case EVENT_SESSION_UNLOCK: return "Session.Unlock";
+        default: return "unknown";
+    }
+}
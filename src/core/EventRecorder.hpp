@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+// Compact binary log of everything that drives the state machine from the outside, see --record and --replay.
+// Events are buffered and written out when the event loop goes idle, on exit and from the crash handler.
+// File: magic, version byte, then per event: type byte, LEB128 time delta (us), value and arg, string count, then length prefixed strings.
+class CEventRecorder {
+  public:
+    enum eEventType : uint8_t {
+        EVENT_START = 1,             // value: 1 if the compositor has hyprland-lock-notify-v1
+        EVENT_IDLED,                 // value: timeout, arg: ignore_inhibit, strings: seat name
+        EVENT_RESUMED,               // value: timeout, arg: ignore_inhibit, strings: seat name
+        EVENT_LOCKED,                // hyprland-lock-notify-v1
+        EVENT_UNLOCKED,              //
+        EVENT_SCREENSAVER_INHIBIT,   // value: cookie handed out, strings: app, reason, sender
+        EVENT_SCREENSAVER_UNINHIBIT, // value: cookie, strings: sender
+        EVENT_OWNER_LOST,            // strings: bus name of a cookie owner that went away
+        EVENT_BLOCK_INHIBITED,       // strings: logind BlockInhibited
+        EVENT_PREPARE_FOR_SLEEP,     // value: sleeping
+        EVENT_SESSION_LOCK,          // logind Session.Lock
+        EVENT_SESSION_UNLOCK,        // logind Session.Unlock
+    };
+
+    struct SEvent {
+        eEventType               type   = EVENT_START;
+        uint64_t                 timeUs = 0; // since the start of the recording
+        uint64_t                 value  = 0;
+        uint64_t                 arg    = 0;
+        std::vector<std::string> strings;
+    };
+
+    CEventRecorder(const std::string& path);
+    ~CEventRecorder();
+
+    bool                                     good() const;
+    void                                     record(eEventType type, uint64_t value = 0, uint64_t arg = 0, std::initializer_list<std::string_view> strings = {});
+    void                                     flush();
+
+    static std::optional<std::vector<SEvent>> load(const std::string& path);
+    static const char*                        typeName(eEventType type);
+
+  private:
+    Hyprutils::OS::CFileDescriptor        m_fd;
+    std::string                           m_pending;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t                              m_lastUs = 0;
+};
+
+inline std::unique_ptr<CEventRecorder> g_pEventRecorder;
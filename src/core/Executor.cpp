@@ -0,0 +1,363 @@
+#include "Executor.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
+#include "Backlight.hpp"
+#include "Hypridle.hpp"
+#include "HyprlandIPC.hpp"
+#include "../config/ConfigManager.hpp"
+#include "../helpers/Log.hpp"
+#include <spawn.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+extern char** environ;
+
+constexpr std::chrono::milliseconds KILL_GRACE_PERIOD = std::chrono::milliseconds{2000};
+// how often children without a pidfd are checked on
+constexpr std::chrono::milliseconds REAP_INTERVAL = std::chrono::milliseconds{100};
+
+// anything in here means we need a shell to interpret the command
+static bool needsShell(const std::string& command) {
+    return command.find_first_of("|&;<>()$`\\\"'*?[]#~={}!\n") != std::string::npos;
+}
+
+static std::vector<std::string> splitArgs(const std::string& command) {
+    std::vector<std::string> args;
+    size_t                   pos = 0;
+
+    while (pos < command.size()) {
+        const auto START = command.find_first_not_of(" \t", pos);
+        if (START == std::string::npos)
+            break;
+
+        const auto END = command.find_first_of(" \t", START);
+        args.emplace_back(command.substr(START, END - START));
+        pos = END;
+    }
+
+    return args;
+}
+
+SP<CExecutor::SProcess> CExecutor::spawn(const std::string& command, const SSpawnOptions& options) {
+    reapUntracked();
+
+    auto process     = makeShared<SProcess>();
+    process->command = command;
+    process->options = options;
+
+    if (m_dryRun) {
+        m_dryRun(command);
+        process->exited = true;
+        notifyExit(process);
+        return process;
+    }
+
+    const auto ACTION = CConfigManager::parseAction(command);
+    if (!ACTION) {
+        Debug::log(ERR, "Not running \"{}\": {}", command, ACTION.error());
+        return nullptr;
+    }
+
+    if (ACTION->type != CConfigManager::SAction::ACTION_COMMAND) {
+        Debug::log(LOG, "Running built-in {}", command);
+
+        process->builtin = true;
+        process->started = std::chrono::steady_clock::now();
+
+        // holds the process until the action is done
+        const auto DONE = [process]() {
+            if (process->exited)
+                return;
+
+            process->exited = true;
+            Debug::log(TRACE, "Built-in {} done after {}ms", process->command,
+                       std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - process->started).count());
+            notifyExit(process);
+        };
+
+        switch (ACTION->type) {
+            case CConfigManager::SAction::ACTION_BACKLIGHT: g_pBacklight->run(*ACTION, DONE); break;
+            case CConfigManager::SAction::ACTION_LOGIND: g_pHypridle->runLogindAction(*ACTION, DONE); break;
+            case CConfigManager::SAction::ACTION_HYPRCTL: g_pHyprlandIPC->run(*ACTION, DONE); break;
+            default: DONE(); break;
+        }
+
+        return process;
+    }
+
+    if (m_maxProcesses > 0 && m_processes.size() >= m_maxProcesses) {
+        Debug::log(WARN, "Process limit of {} reached, queueing {}", m_maxProcesses, command);
+        m_queue.push_back(process);
+        return process;
+    }
+
+    if (!start(process))
+        return nullptr;
+
+    return process;
+}
+
+bool CExecutor::start(SP<SProcess> process) {
+    Debug::log(LOG, "Executing {}", process->command);
+
+    std::vector<std::string> args;
+    if (needsShell(process->command))
+        args = {"/bin/sh", "-c", process->command};
+    else
+        args = splitArgs(process->command);
+
+    if (args.empty()) {
+        Debug::log(ERR, "Refusing to run an empty command");
+        return false;
+    }
+
+    std::vector<char*> argv;
+    argv.reserve(args.size() + 1);
+    for (auto& a : args) {
+        argv.push_back(a.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    // our handlers and blocked signals must not leak into the child
+    sigset_t sigmask, sigdefault;
+    sigemptyset(&sigmask);
+    sigfillset(&sigdefault);
+    posix_spawnattr_setsigmask(&attr, &sigmask);
+    posix_spawnattr_setsigdefault(&attr, &sigdefault);
+
+    // a fresh process group, so that cancelling also gets whatever the command forked
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    // glibc already uses CLONE_VFORK semantics, the flag is only there for older versions
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_USEVFORK);
+
+    const auto BEGIN = std::chrono::steady_clock::now();
+    pid_t      pid   = -1;
+    const int  RET   = posix_spawnp(&pid, argv[0], nullptr, &attr, argv.data(), environ);
+    const auto END   = std::chrono::steady_clock::now();
+
+    posix_spawnattr_destroy(&attr);
+
+    g_pMetrics->onSpawn(RET == 0, END - BEGIN);
+
+    if (g_pTracer) {
+        g_pTracer->complete("spawn", "process", BEGIN, END, process->command);
+        if (RET == 0)
+            g_pTracer->asyncBegin("process", "process", pid, process->command);
+    }
+
+    if (RET != 0) {
+        Debug::log(ERR, "Failed to run \"{}\": {}", process->command, strerror(RET));
+        return false;
+    }
+
+    Debug::log(LOG, "Process Created with pid {}", pid);
+    Debug::log(TRACE, "Spawning {} took {}us", pid, std::chrono::duration_cast<std::chrono::microseconds>(END - BEGIN).count());
+
+    process->pid     = pid;
+    process->started = BEGIN;
+    process->pidfd   = Hyprutils::OS::CFileDescriptor{(int)syscall(SYS_pidfd_open, pid, 0)};
+
+    if (process->pidfd.isValid())
+        g_pEventLoop->addFd(process->pidfd.get(), EPOLLIN, [this, pid](uint32_t) { onProcessExited(pid); });
+    else
+        Debug::log(WARN, "pidfd_open failed for {} ({}), polling for its exit instead", pid, strerror(errno));
+
+    if (process->options.deadline.count() > 0) {
+        process->deadlineTimer = g_pEventLoop->addTimer(process->options.deadline, [this, wp = WP<SProcess>{process}]() {
+            const auto PROCESS = wp.lock();
+            if (!PROCESS)
+                return;
+
+            PROCESS->deadlineTimer = 0;
+            Debug::log(WARN, "Process {} ({}) exceeded its deadline of {}ms", PROCESS->pid, PROCESS->command, PROCESS->options.deadline.count());
+            cancel(PROCESS);
+        });
+    }
+
+    m_processes[pid] = process;
+
+    if (!process->pidfd.isValid())
+        scheduleReap();
+
+    return true;
+}
+
+void CExecutor::cancel(SP<SProcess> process) {
+    if (!process || process->exited)
+        return;
+
+    // built-ins are short, and the next one on the same target supersedes them anyway
+    if (process->builtin)
+        return;
+
+    if (process->pid < 0) {
+        Debug::log(LOG, "Dropping queued command {}", process->command);
+        std::erase(m_queue, process);
+        process->exited = true;
+        notifyExit(process);
+        return;
+    }
+
+    if (process->killTimer)
+        return; // already on its way out
+
+    Debug::log(LOG, "Terminating process group {} ({})", process->pid, process->command);
+    kill(-process->pid, SIGTERM);
+
+    process->killTimer = g_pEventLoop->addTimer(KILL_GRACE_PERIOD, [wp = WP<SProcess>{process}]() {
+        const auto PROCESS = wp.lock();
+        if (!PROCESS || PROCESS->exited)
+            return;
+
+        PROCESS->killTimer = 0;
+        Debug::log(WARN, "Process {} ({}) ignored SIGTERM, killing its process group", PROCESS->pid, PROCESS->command);
+        kill(-PROCESS->pid, SIGKILL);
+    });
+}
+
+// WNOHANG waitpid that retries on EINTR. Anything else, usually ECHILD because it got reaped elsewhere (or SIGCHLD is ignored), means it's gone.
+static pid_t reapChild(pid_t pid, int& status) {
+    pid_t ret = 0;
+    do {
+        ret = waitpid(pid, &status, WNOHANG);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret;
+}
+
+void CExecutor::onProcessExited(pid_t pid) {
+    const auto IT = m_processes.find(pid);
+    if (IT == m_processes.end())
+        return;
+
+    int         status = 0;
+    const pid_t RET    = reapChild(pid, status);
+    if (RET == 0)
+        return; // spurious
+
+    const int WAITERR = RET < 0 ? errno : 0;
+
+    const auto PROCESS = IT->second;
+    const auto RUNTIME = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - PROCESS->started).count();
+
+    // there's nothing left to wait for, retrying would only spin on the pidfd
+    if (RET < 0)
+        Debug::log(WARN, "Process {} ({}) can't be reaped after {}ms ({}), dropping it", pid, PROCESS->command, RUNTIME, strerror(WAITERR));
+    else if (WIFEXITED(status))
+        Debug::log(LOG, "Process {} ({}) exited with status {} after {}ms", pid, PROCESS->command, WEXITSTATUS(status), RUNTIME);
+    else if (WIFSIGNALED(status))
+        Debug::log(LOG, "Process {} ({}) was killed by signal {} after {}ms", pid, PROCESS->command, WTERMSIG(status), RUNTIME);
+
+    PROCESS->exited = true;
+
+    if (g_pTracer)
+        g_pTracer->asyncEnd("process", "process", pid, PROCESS->command);
+
+    if (PROCESS->pidfd.isValid())
+        g_pEventLoop->removeFd(PROCESS->pidfd.get());
+
+    if (PROCESS->deadlineTimer)
+        g_pEventLoop->removeTimer(PROCESS->deadlineTimer);
+
+    // the group might outlive its leader, but once we reaped it, the pgid can be reused. Stop here.
+    if (PROCESS->killTimer)
+        g_pEventLoop->removeTimer(PROCESS->killTimer);
+
+    m_processes.erase(IT);
+
+    notifyExit(PROCESS);
+
+    startQueued();
+}
+
+void CExecutor::startQueued() {
+    while (!m_queue.empty() && (m_maxProcesses == 0 || m_processes.size() < m_maxProcesses)) {
+        auto process = m_queue.front();
+        m_queue.pop_front();
+
+        if (!start(process)) {
+            process->exited = true;
+            notifyExit(process);
+        }
+    }
+}
+
+void CExecutor::scheduleReap() {
+    if (m_reapTimer)
+        return;
+
+    // no pidfd means nothing wakes us up when the child exits, onExit and whatever waits on it would hang until the next spawn
+    m_reapTimer = g_pEventLoop->addTimer(REAP_INTERVAL, [this]() {
+        m_reapTimer = 0;
+        reapUntracked();
+
+        if (std::ranges::any_of(m_processes, [](const auto& p) { return !p.second->pidfd.isValid(); }))
+            scheduleReap();
+    });
+}
+
+void CExecutor::reapUntracked() {
+    std::vector<pid_t> exited;
+    for (const auto& [pid, process] : m_processes) {
+        if (process->pidfd.isValid())
+            continue;
+
+        int         status = 0;
+        const pid_t RET    = reapChild(pid, status);
+        if (RET == pid || RET < 0)
+            exited.push_back(pid);
+    }
+
+    for (const auto PID : exited) {
+        Debug::log(LOG, "Process {} ({}) exited", PID, m_processes[PID]->command);
+
+        auto process    = m_processes[PID];
+        process->exited = true;
+
+        if (g_pTracer)
+            g_pTracer->asyncEnd("process", "process", PID, process->command);
+
+        if (process->deadlineTimer)
+            g_pEventLoop->removeTimer(process->deadlineTimer);
+        if (process->killTimer)
+            g_pEventLoop->removeTimer(process->killTimer);
+
+        m_processes.erase(PID);
+
+        notifyExit(process);
+    }
+
+    if (!exited.empty())
+        startQueued();
+}
+
+void CExecutor::notifyExit(SP<SProcess> process) {
+    // at most once, whatever the callback ends up doing
+    if (const auto CALLBACK = std::exchange(process->options.onExit, nullptr))
+        CALLBACK();
+}
+
+void CExecutor::setMaxProcesses(size_t max) {
+    m_maxProcesses = max;
+}
+
+size_t CExecutor::runningProcesses() const {
+    return m_processes.size();
+}
+
+void CExecutor::setDryRun(DryRunCallback callback) {
+    m_dryRun = std::move(callback);
+}
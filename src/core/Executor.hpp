@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+#include "../defines.hpp"
+
+struct SSpawnOptions {
+    // kill the process group if it is still running after this long, 0 means never
+    std::chrono::milliseconds deadline = std::chrono::milliseconds{0};
+    // called once when the process is gone: exited, reaped, dropped from the queue, or right away on a dry run. Not called if spawn fails.
+    std::function<void()> onExit;
+};
+
+class CExecutor {
+  public:
+    struct SProcess {
+        pid_t                                 pid = -1; // -1 while queued
+        std::string                           command;
+        SSpawnOptions                         options;
+        Hyprutils::OS::CFileDescriptor        pidfd;
+        std::chrono::steady_clock::time_point started;
+        uint64_t                              deadlineTimer = 0;
+        uint64_t                              killTimer     = 0;
+        bool                                  exited        = false;
+        bool                                  builtin       = false; // a built-in action, no child behind it
+    };
+
+    // Runs command without waiting for it. Commands without shell syntax are executed directly,
+    // everything else goes through /bin/sh -c. Every child leads its own process group.
+    // Built-in actions (see CConfigManager::parseAction) run in-process, the returned process exits once they're done.
+    // If the process limit is reached the command is queued until another child exits.
+    // Returns nullptr on failure.
+    SP<SProcess> spawn(const std::string& command, const SSpawnOptions& options = {});
+
+    // SIGTERM to the process group, SIGKILL if it is still around after a grace period.
+    // Queued processes are dropped.
+    void   cancel(SP<SProcess> process);
+
+    void   setMaxProcesses(size_t max);
+    size_t runningProcesses() const;
+
+    // nothing gets executed, commands are handed to the callback instead and reported as exited right away
+    using DryRunCallback = std::function<void(const std::string& command)>;
+    void setDryRun(DryRunCallback callback);
+
+  private:
+    bool                                     start(SP<SProcess> process);
+    void                                     onProcessExited(pid_t pid);
+    void                                     startQueued();
+    void                                     reapUntracked();
+    void                                     scheduleReap();
+    static void                              notifyExit(SP<SProcess> process);
+
+    std::unordered_map<pid_t, SP<SProcess>> m_processes;
+    std::deque<SP<SProcess>>                m_queue;
+    size_t                                  m_maxProcesses = 0;
+    DryRunCallback                          m_dryRun;
+    uint64_t                                m_reapTimer = 0;
+};
+
+inline std::unique_ptr<CExecutor> g_pExecutor;
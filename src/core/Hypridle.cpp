@@ -1,27 +1,88 @@
 
 #include "Hypridle.hpp"
+#include "EventLoop.hpp"
+#include "Executor.hpp"
+#include "Tracer.hpp"
+#include "EventRecorder.hpp"
+#include "HyprlandIPC.hpp"
 #include "../helpers/Log.hpp"
+#include "../helpers/SdNotify.hpp"
 #include "../config/ConfigManager.hpp"
+#include "../config/ConfigWatcher.hpp"
 #include "csignal"
 #include <sys/wait.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <fnmatch.h>
 #include <unistd.h>
 #include <algorithm>
-#include <thread>
-#include <mutex>
-#include <hyprutils/os/Process.hpp>
+#include <map>
+#include <unordered_map>
 
-CHypridle::CHypridle() {
-    m_sWaylandState.display = wl_display_connect(nullptr);
-    if (!m_sWaylandState.display) {
+// backoff of the attempts to reconnect after losing the compositor
+constexpr std::chrono::milliseconds RECONNECT_MIN_DELAY = std::chrono::milliseconds{250};
+constexpr std::chrono::milliseconds RECONNECT_MAX_DELAY = std::chrono::milliseconds{10000};
+
+void CHypridle::run() {
+    startupPhase("config");
+
+    if (!connectWayland(nullptr)) {
         Debug::log(CRIT, "Couldn't connect to a wayland compositor");
         exit(1);
     }
+
+    // the compositor sends the globals while we connect to the system bus, the roundtrip below just collects them
+    startupPhase("wayland connect");
+
+    try {
+        m_sDBUSState.connection = sdbus::createSystemBusConnection();
+    } catch (std::exception& e) {
+        Debug::log(CRIT, "Couldn't create the dbus connection ({})", e.what());
+        exit(1);
+    }
+
+    setupDBUS();
+    startupPhase("system bus");
+
+    wl_display_roundtrip(m_sWaylandState.display);
+    startupPhase("wayland globals");
+
+    if (!m_sWaylandIdleState.notifier) {
+        Debug::log(CRIT, "Couldn't bind to ext-idle-notifier-v1, does your compositor support it?");
+        exit(1);
+    }
+
+    armWayland();
+
+    if (g_pEventRecorder)
+        g_pEventRecorder->record(CEventRecorder::EVENT_START, !!m_sWaylandState.lockNotifier);
+
+    startupPhase("listeners");
+
+    if (!m_sWaylandState.lockNotifier)
+        Debug::log(WARN,
+                   "Compositor is missing hyprland-lock-notify-v1!\n"
+                   "general:inhibit_sleep=3, general:on_lock_cmd and general:on_unlock_cmd will not work.");
+
+    setupSleepInhibitBehavior(!!m_sWaylandState.lockNotifier);
+
+    static const auto MAXPROCESSES = g_pConfigManager->getValue<Hyprlang::INT>("general:max_processes");
+    g_pExecutor->setMaxProcesses(std::max<Hyprlang::INT>(*MAXPROCESSES, 0));
+
+    if (m_inhibitSleepBehavior != SLEEP_INHIBIT_NONE)
+        inhibitSleep();
+    startupPhase("sleep inhibitor");
+
+    enterEventLoop();
 }
 
-void CHypridle::run() {
+bool CHypridle::connectWayland(const char* name) {
+    m_sWaylandState.display = wl_display_connect(name);
+    if (!m_sWaylandState.display)
+        return false;
+
     m_sWaylandState.registry = makeShared<CCWlRegistry>((wl_proxy*)wl_display_get_registry(m_sWaylandState.display));
     m_sWaylandState.registry->setGlobal([this](CCWlRegistry* r, uint32_t name, const char* interface, uint32_t version) {
         const std::string IFACE = interface;
@@ -30,84 +91,229 @@ void CHypridle::run() {
         if (IFACE == ext_idle_notifier_v1_interface.name) {
             m_sWaylandIdleState.notifier =
                 makeShared<CCExtIdleNotifierV1>((wl_proxy*)wl_registry_bind((wl_registry*)r->resource(), name, &ext_idle_notifier_v1_interface, version));
+            m_sWaylandIdleState.notifierName = name;
             Debug::log(LOG, "   > Bound to {} v{}", IFACE, version);
+
+            // came back after going away, the groups that lost their notification get a new one
+            if (m_sWaylandState.armed)
+                updateListeners();
         } else if (IFACE == hyprland_lock_notifier_v1_interface.name) {
             m_sWaylandState.lockNotifier =
                 makeShared<CCHyprlandLockNotifierV1>((wl_proxy*)wl_registry_bind((wl_registry*)r->resource(), name, &hyprland_lock_notifier_v1_interface, version));
+            m_sWaylandState.lockNotifierName = name;
             Debug::log(LOG, "   > Bound to {} v{}", IFACE, version);
-        } else if (IFACE == wl_seat_interface.name) {
-            if (m_sWaylandState.seat) {
-                Debug::log(WARN, "Hypridle does not support multi-seat configurations. Only binding to the first seat.");
-                return;
-            }
 
-            m_sWaylandState.seat = makeShared<CCWlSeat>((wl_proxy*)wl_registry_bind((wl_registry*)r->resource(), name, &wl_seat_interface, version));
-            Debug::log(LOG, "   > Bound to {} v{}", IFACE, version);
-        }
+            if (m_sWaylandState.armed)
+                setupLockNotification();
+        } else if (IFACE == wl_seat_interface.name)
+            addSeat(name, version);
     });
 
-    m_sWaylandState.registry->setGlobalRemove([](CCWlRegistry* r, uint32_t name) { Debug::log(LOG, "  | removed iface {}", name); });
+    m_sWaylandState.registry->setGlobalRemove([this](CCWlRegistry* r, uint32_t name) {
+        Debug::log(LOG, "  | removed iface {}", name);
+
+        if (name == m_sWaylandIdleState.notifierName) {
+            Debug::log(WARN, "ext-idle-notifier-v1 went away, listeners stay unarmed until it's back");
+            dropIdleNotifications();
+            m_sWaylandIdleState.notifier->sendDestroy();
+            m_sWaylandIdleState.notifier.reset();
+            m_sWaylandIdleState.notifierName = 0;
+        } else if (name == m_sWaylandState.lockNotifierName) {
+            Debug::log(WARN, "hyprland-lock-notify-v1 went away");
+            if (m_sWaylandState.lockNotification)
+                m_sWaylandState.lockNotification->sendDestroy();
+            m_sWaylandState.lockNotification.reset();
+            m_sWaylandState.lockNotifier->sendDestroy();
+            m_sWaylandState.lockNotifier.reset();
+            m_sWaylandState.lockNotifierName = 0;
+
+            // nobody is going to tell us about the unlock anymore. Like losing the compositor, that's no unlock to act on.
+            if (m_isLocked) {
+                m_isLocked = false;
+                if (m_inhibitSleepBehavior == SLEEP_INHIBIT_LOCK_NOTIFY)
+                    inhibitSleep();
+            }
+        } else
+            removeSeat(name);
+    });
 
-    wl_display_roundtrip(m_sWaylandState.display);
+    wl_display_flush(m_sWaylandState.display);
+    return true;
+}
 
-    if (!m_sWaylandIdleState.notifier) {
-        Debug::log(CRIT, "Couldn't bind to ext-idle-notifier-v1, does your compositor support it?");
-        exit(1);
-    }
+void CHypridle::armWayland() {
+    if (m_sWaylandIdleState.seats.empty())
+        Debug::log(WARN, "Compositor has no seat yet, listeners get armed once it announces one");
 
-    static const auto IGNOREWAYLANDINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_wayland_inhibit");
+    updateListeners();
+    setupLockNotification();
 
-    const auto        RULES = g_pConfigManager->getRules();
-    m_sWaylandIdleState.listeners.resize(RULES.size());
+    m_sWaylandState.armed = true;
+}
 
-    Debug::log(LOG, "found {} rules", RULES.size());
+void CHypridle::setupLockNotification() {
+    if (!m_sWaylandState.lockNotifier)
+        return;
 
-    for (size_t i = 0; i < RULES.size(); ++i) {
-        auto&       l   = m_sWaylandIdleState.listeners[i];
-        const auto& r   = RULES[i];
-        l.onRestore     = r.onResume;
-        l.onTimeout     = r.onTimeout;
-        l.ignoreInhibit = r.ignoreInhibit;
+    m_sWaylandState.lockNotification = makeShared<CCHyprlandLockNotificationV1>(m_sWaylandState.lockNotifier->sendGetLockNotification());
+    m_sWaylandState.lockNotification->setLocked([this](CCHyprlandLockNotificationV1* n) { onLocked(); });
+    m_sWaylandState.lockNotification->setUnlocked([this](CCHyprlandLockNotificationV1* n) { onUnlocked(); });
+}
 
-        if (*IGNOREWAYLANDINHIBIT || r.ignoreInhibit)
-            l.notification =
-                makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetInputIdleNotification(r.timeout * 1000 /* ms */, m_sWaylandState.seat->resource()));
-        else
-            l.notification =
-                makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetIdleNotification(r.timeout * 1000 /* ms */, m_sWaylandState.seat->resource()));
+void CHypridle::dropIdleNotifications() {
+    for (auto& l : m_sWaylandIdleState.listeners) {
+        if (!l->settleNotification)
+            continue;
 
-        l.notification->setData(&m_sWaylandIdleState.listeners[i]);
+        dropResumeSettle(l.get());
 
-        l.notification->setIdled([this](CCExtIdleNotificationV1* n) { onIdled((CHypridle::SIdleListener*)n->data()); });
-        l.notification->setResumed([this](CCExtIdleNotificationV1* n) { onResumed((CHypridle::SIdleListener*)n->data()); });
+        // held after a blip, with nothing left to report the next input that's the safer side
+        if (!l->pendingResume) {
+            m_eventBegin = std::chrono::steady_clock::now();
+            runOnResume(l.get());
+        }
     }
 
-    wl_display_roundtrip(m_sWaylandState.display);
+    for (auto& seat : m_sWaylandIdleState.seats) {
+        for (auto& g : seat->groups) {
+            if (g->notification)
+                g->notification->sendDestroy();
+            if (g->derivedTimer)
+                g_pEventLoop->removeTimer(g->derivedTimer);
+
+            g->notification.reset();
+            g->derivedTimer = 0;
+            g->idled        = false;
+            g->missedIdle   = false;
+        }
 
-    if (m_sWaylandState.lockNotifier) {
-        m_sWaylandState.lockNotification = makeShared<CCHyprlandLockNotificationV1>(m_sWaylandState.lockNotifier->sendGetLockNotification());
-        m_sWaylandState.lockNotification->setLocked([this](CCHyprlandLockNotificationV1* n) { onLocked(); });
-        m_sWaylandState.lockNotification->setUnlocked([this](CCHyprlandLockNotificationV1* n) { onUnlocked(); });
+        seat->idled = false;
     }
+}
 
-    Debug::log(LOG, "wayland done, registering dbus");
+void CHypridle::onWaylandDisconnected() {
+    Debug::log(ERR, "[core] Disconnected from the wayland compositor, the bus side stays up while we reconnect");
+    SdNotify::notify("STATUS=Reconnecting to the wayland compositor");
 
-    try {
-        m_sDBUSState.connection = sdbus::createSystemBusConnection();
-    } catch (std::exception& e) {
-        Debug::log(CRIT, "Couldn't create the dbus connection ({})", e.what());
-        exit(1);
+    g_pEventLoop->removeFd(wl_display_get_fd(m_sWaylandState.display));
+
+    // every proxy has to go before the display does. Seats take their listeners along, updateListeners() rebuilds them from the rules for the new seats.
+    m_sWaylandState.armed = false;
+    while (!m_sWaylandIdleState.seats.empty()) {
+        removeSeat(m_sWaylandIdleState.seats.front()->registryName);
     }
 
-    if (!m_sWaylandState.lockNotifier)
-        Debug::log(WARN,
-                   "Compositor is missing hyprland-lock-notify-v1!\n"
-                   "general:inhibit_sleep=3, general:on_lock_cmd and general:on_unlock_cmd will not work.");
+    m_sWaylandIdleState.notifier.reset();
+    m_sWaylandState.reconnectSync.reset();
+    m_sWaylandState.lockNotification.reset();
+    m_sWaylandState.lockNotifier.reset();
+    m_sWaylandState.registry.reset();
+    m_sWaylandIdleState.notifierName = 0;
+    m_sWaylandState.lockNotifierName = 0;
+
+    wl_display_disconnect(m_sWaylandState.display);
+    m_sWaylandState.display = nullptr;
+
+    // the lock went down with the compositor, the new one tells us if it's locked again
+    if (m_isLocked) {
+        m_isLocked = false;
+        if (m_inhibitSleepBehavior == SLEEP_INHIBIT_LOCK_NOTIFY)
+            inhibitSleep();
+    }
+
+    m_sWaylandState.reconnectDelay = RECONNECT_MIN_DELAY;
+    m_sWaylandState.reconnectTimer = g_pEventLoop->addTimer(m_sWaylandState.reconnectDelay, [this]() { reconnectWayland(); });
+}
+
+void CHypridle::reconnectWayland() {
+    m_sWaylandState.reconnectTimer = 0;
+
+    // only the display we were started on. Another wayland-* socket may well belong to a different, e.g. nested, compositor.
+    if (!connectWayland(nullptr)) {
+        m_sWaylandState.reconnectDelay = std::min(m_sWaylandState.reconnectDelay * 2, RECONNECT_MAX_DELAY);
+        Debug::log(LOG, "[core] No wayland compositor to reconnect to, trying again in {}ms", m_sWaylandState.reconnectDelay.count());
+
+        m_sWaylandState.reconnectTimer = g_pEventLoop->addTimer(m_sWaylandState.reconnectDelay, [this]() { reconnectWayland(); });
+        return;
+    }
+
+    Debug::log(LOG, "[core] Reconnected to the wayland compositor");
+
+    // no roundtrip, a compositor that accepted us but doesn't answer must not block the bus side. Once the sync is done, the globals are in.
+    m_sWaylandState.reconnectSync = makeShared<CCWlCallback>((wl_proxy*)wl_display_sync(m_sWaylandState.display));
+    m_sWaylandState.reconnectSync->setDone([this](CCWlCallback* cb, uint32_t data) {
+        if (!m_sWaylandIdleState.notifier)
+            Debug::log(ERR, "The compositor has no ext-idle-notifier-v1 (yet), listeners get armed once it shows up");
+
+        // hyprctl: actions and the hyprctl our commands run have to reach the new instance
+        g_pHyprlandIPC->followInstance();
+
+        armWayland();
+        SdNotify::notify(std::format("STATUS={} listeners armed", m_sWaylandIdleState.listeners.size()));
+    });
+
+    wl_display_flush(m_sWaylandState.display);
+    g_pEventLoop->addFd(wl_display_get_fd(m_sWaylandState.display), EPOLLIN, [this](uint32_t events) { dispatchWayland(events); });
+}
+
+void CHypridle::enableStartupProfile(std::chrono::steady_clock::time_point processStart) {
+    m_sStartupState.profile   = true;
+    m_sStartupState.lastPhase = processStart;
+    m_sStartupState.start     = processStart;
+}
+
+void CHypridle::startupPhase(const char* name) {
+    if (!m_sStartupState.profile)
+        return;
 
+    const auto NOW = std::chrono::steady_clock::now();
+    m_sStartupState.phases.emplace_back(name, NOW - m_sStartupState.lastPhase);
+    m_sStartupState.lastPhase = NOW;
+}
+
+void CHypridle::onStartupDone() {
+    Debug::log(LOG, "Startup done");
+
+    m_sStartupState.done = true;
+    notifyReady();
+
+    if (!m_sStartupState.profile)
+        return;
+
+    const auto TOTAL = std::chrono::steady_clock::now() - m_sStartupState.start;
+
+    Debug::log(NONE, "Startup profile (us):");
+    for (const auto& [name, duration] : m_sStartupState.phases) {
+        Debug::log(NONE, "  {:<20} {}", name, std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+    Debug::log(NONE, "  {:<20} {}", "total", std::chrono::duration_cast<std::chrono::microseconds>(TOTAL).count());
+
+    m_sStartupState.phases.clear();
+}
+
+void CHypridle::notifyReady() {
+    // listeners armed, ScreenSaver owned and the sleep inhibitor taken (or given up on)
+    if (m_sStartupState.readySent || !m_sStartupState.done || m_sDBUSState.sleepInhibitTimer)
+        return;
+
+    m_sStartupState.readySent = true;
+    SdNotify::notify(std::format("READY=1\nSTATUS={} listeners armed", m_sWaylandIdleState.listeners.size()));
+}
+
+void CHypridle::watchdogPing() {
+    SdNotify::notify("WATCHDOG=1");
+
+    // from a timer, so that a wedged dispatch stops the pings and systemd restarts us
+    g_pEventLoop->addTimer(std::chrono::duration_cast<std::chrono::milliseconds>(m_sStartupState.watchdogInterval / 2), [this]() { watchdogPing(); });
+}
+
+void CHypridle::setupSleepInhibitBehavior(bool lockNotify) {
     static const auto INHIBIT  = g_pConfigManager->getValue<Hyprlang::INT>("general:inhibit_sleep");
     static const auto SLEEPCMD = g_pConfigManager->getValue<Hyprlang::STRING>("general:before_sleep_cmd");
     static const auto LOCKCMD  = g_pConfigManager->getValue<Hyprlang::STRING>("general:lock_cmd");
 
+    m_inhibitSleepBehavior = SLEEP_INHIBIT_NONE;
+
     switch (*INHIBIT) {
         case 0: // disabled
             m_inhibitSleepBehavior = SLEEP_INHIBIT_NONE;
@@ -116,15 +322,15 @@ void CHypridle::run() {
             m_inhibitSleepBehavior = SLEEP_INHIBIT_NORMAL;
             break;
         case 2: { // auto (enable, but wait until locked if before_sleep_cmd contains hyprlock, or loginctl lock-session and lock_cmd contains hyprlock.)
-            if (m_sWaylandState.lockNotifier && std::string{*SLEEPCMD}.contains("hyprlock"))
+            if (lockNotify && std::string{*SLEEPCMD}.contains("hyprlock"))
                 m_inhibitSleepBehavior = SLEEP_INHIBIT_LOCK_NOTIFY;
-            else if (m_sWaylandState.lockNotifier && std::string{*LOCKCMD}.contains("hyprlock") && std::string{*SLEEPCMD}.contains("lock-session"))
+            else if (lockNotify && std::string{*LOCKCMD}.contains("hyprlock") && std::string{*SLEEPCMD}.contains("lock-session"))
                 m_inhibitSleepBehavior = SLEEP_INHIBIT_LOCK_NOTIFY;
             else
                 m_inhibitSleepBehavior = SLEEP_INHIBIT_NORMAL;
         } break;
         case 3: // wait until locked
-            if (m_sWaylandState.lockNotifier)
+            if (lockNotify)
                 m_inhibitSleepBehavior = SLEEP_INHIBIT_LOCK_NOTIFY;
             break;
         default: Debug::log(ERR, "Invalid inhibit_sleep value: {}", *INHIBIT); break;
@@ -135,213 +341,814 @@ void CHypridle::run() {
         case SLEEP_INHIBIT_NORMAL: Debug::log(LOG, "Sleep inhibition enabled"); break;
         case SLEEP_INHIBIT_LOCK_NOTIFY: Debug::log(LOG, "Sleep inhibition enabled - inhibiting until the wayland session gets locked"); break;
     }
-
-    setupDBUS();
-    if (m_inhibitSleepBehavior != SLEEP_INHIBIT_NONE)
-        inhibitSleep();
-    enterEventLoop();
 }
 
 void CHypridle::enterEventLoop() {
+    g_pEventLoop->setSignalHandler([this](int sig) { onSignal(sig); });
 
-    nfds_t pollfdsCount = m_sDBUSState.screenSaverServiceConnection ? 3 : 2;
-
-    pollfd pollfds[] = {
-        {
-            .fd     = m_sDBUSState.connection->getEventLoopPollData().fd,
-            .events = POLLIN,
-        },
-        {
-            .fd     = wl_display_get_fd(m_sWaylandState.display),
-            .events = POLLIN,
-        },
-        {
-            .fd     = m_sDBUSState.screenSaverServiceConnection ? m_sDBUSState.screenSaverServiceConnection->getEventLoopPollData().fd : 0,
-            .events = POLLIN,
-        },
-    };
+    g_pConfigWatcher->setOnChange([this]() { reloadConfig(); });
+    g_pConfigWatcher->setWatchList(g_pConfigManager->configFiles());
 
-    std::thread pollThr([this, &pollfds, &pollfdsCount]() {
-        while (1) {
-            int ret = poll(pollfds, pollfdsCount, 5000 /* 5 seconds, reasonable. It's because we might need to terminate */);
-            if (ret < 0) {
-                Debug::log(CRIT, "[core] Polling fds failed with {}", errno);
-                m_bTerminate = true;
-                exit(1);
-            }
+    g_pEventLoop->addFd(wl_display_get_fd(m_sWaylandState.display), EPOLLIN, [this](uint32_t events) { dispatchWayland(events); });
 
-            for (size_t i = 0; i < pollfdsCount; ++i) {
-                if (pollfds[i].revents & POLLHUP) {
-                    Debug::log(CRIT, "[core] Disconnected from pollfd id {}", i);
-                    m_bTerminate = true;
-                    exit(1);
-                }
-            }
+    // anything queued or sent by the other sources has to be out before we block. Registered ahead of the bus watches,
+    // so the bus messages of the actions started here are accounted for by their hooks.
+    g_pEventLoop->addPreWaitHook([this]() {
+        if (m_sWaylandState.display) {
+            TRACE_SPAN("wl_display_dispatch_pending", "dispatch");
+            wl_display_dispatch_pending(m_sWaylandState.display);
+        }
 
-            if (m_bTerminate)
-                break;
+        // idled/resumed dispatched just now queue their actions as well
+        flushActions();
 
-            if (ret != 0) {
-                Debug::log(TRACE, "[core] got poll event");
-                std::lock_guard<std::mutex> lg(m_sEventLoopInternals.loopRequestMutex);
-                m_sEventLoopInternals.shouldProcess = true;
-                m_sEventLoopInternals.loopSignal.notify_all();
-            }
+        if (m_sWaylandState.display) {
+            TRACE_SPAN("wl_display_flush", "dispatch");
+            wl_display_flush(m_sWaylandState.display);
         }
     });
 
-    while (1) { // dbus events
-        // wait for being awakened
-        m_sEventLoopInternals.loopRequestMutex.unlock(); // unlock, we are ready to take events
+    watchDbusConnection(m_sDBUSState.connection.get(), CMetrics::EVENT_SOURCE_SYSTEM_BUS);
+
+    m_sStartupState.watchdogInterval = SdNotify::watchdogInterval();
+    if (m_sStartupState.watchdogInterval.count() > 0) {
+        Debug::log(LOG, "systemd watchdog enabled, pinging every {}ms", m_sStartupState.watchdogInterval.count() / 2000);
+        watchdogPing();
+    }
+
+    // idle handling works without it, so it doesn't hold up getting there
+    g_pEventLoop->addTimer(std::chrono::milliseconds{0}, [this]() {
+        setupScreenSaver();
+        startupPhase("screensaver");
+        onStartupDone();
+    });
+
+    g_pEventLoop->enter();
+
+    Debug::log(LOG, "[core] Terminating");
+
+    SdNotify::notify("STOPPING=1");
+
+    if (g_pTracer)
+        g_pTracer->write();
+
+    if (sleepInhibitActive())
+        uninhibitSleep();
+
+    if (m_sWaylandState.display)
+        wl_display_flush(m_sWaylandState.display);
+}
+
+struct SDbusWatch {
+    sdbus::IConnection*    connection = nullptr;
+    CMetrics::eEventSource source     = CMetrics::EVENT_SOURCE_SYSTEM_BUS;
+    int                    fd         = -1;
+    uint32_t               events     = EPOLLIN;
+    uint64_t               timer      = 0;
+
+    // absolute, as sd-bus reports it. The timer is only replaced when this changes.
+    decltype(sdbus::IConnection::PollData::timeout) deadline{};
+};
 
-        std::unique_lock lk(m_sEventLoopInternals.loopMutex);
-        if (!m_sEventLoopInternals.shouldProcess) // avoid a lock if a thread managed to request something already since we .unlock()ed
-            m_sEventLoopInternals.loopSignal.wait(lk, [this] { return m_sEventLoopInternals.shouldProcess == true; }); // wait for events
+static void dispatchDbus(const SP<SDbusWatch>& watch);
 
-        m_sEventLoopInternals.loopRequestMutex.lock(); // lock incoming events
+// sd-bus wants POLLOUT while its write queue is backed up, and a wakeup for the timeouts of its pending method calls.
+// Both change with every message, so they're picked up after each dispatch and right before we block.
+static void rearmDbusWatch(const SP<SDbusWatch>& watch) {
+    const auto     DATA   = watch->connection->getEventLoopPollData();
+    const uint32_t EVENTS = ((DATA.events & POLLIN) ? EPOLLIN : 0) | ((DATA.events & POLLOUT) ? EPOLLOUT : 0);
 
-        if (m_bTerminate)
+    if (EVENTS != watch->events && g_pEventLoop->modifyFd(watch->fd, EVENTS))
+        watch->events = EVENTS;
+
+    if (watch->timer && DATA.timeout == watch->deadline)
+        return;
+
+    if (watch->timer)
+        g_pEventLoop->removeTimer(watch->timer);
+    watch->timer    = 0;
+    watch->deadline = DATA.timeout;
+
+    // -1 is no timeout
+    if (const int TIMEOUT = DATA.getPollTimeout(); TIMEOUT >= 0) {
+        watch->timer = g_pEventLoop->addTimer(std::chrono::milliseconds(TIMEOUT), [watch]() {
+            watch->timer = 0;
+            dispatchDbus(watch);
+        });
+    }
+}
+
+static void dispatchDbus(const SP<SDbusWatch>& watch) {
+    Debug::log(TRACE, "got dbus event");
+    TRACE_SPAN(watch->source == CMetrics::EVENT_SOURCE_SYSTEM_BUS ? "system bus" : "session bus", "dispatch");
+
+    const auto BEGIN = std::chrono::steady_clock::now();
+    while (watch->connection->processPendingEvent()) {
+        ;
+    }
+    g_pMetrics->onDispatch(watch->source, std::chrono::steady_clock::now() - BEGIN);
+
+    rearmDbusWatch(watch);
+}
+
+void CHypridle::watchDbusConnection(sdbus::IConnection* connection, CMetrics::eEventSource source) {
+    const auto POLLDATA = connection->getEventLoopPollData();
+    const auto WATCH    = makeShared<SDbusWatch>(SDbusWatch{.connection = connection, .source = source, .fd = POLLDATA.fd});
+
+    g_pEventLoop->addFd(POLLDATA.fd, EPOLLIN, [WATCH](uint32_t) { dispatchDbus(WATCH); });
+    // signalled by sdbus when messages got queued outside of processPendingEvent (e.g. during a synchronous call)
+    if (POLLDATA.eventFd >= 0)
+        g_pEventLoop->addFd(POLLDATA.eventFd, EPOLLIN, [WATCH](uint32_t) { dispatchDbus(WATCH); });
+
+    // calls made from timers and the other sources queue messages and start timeouts as well
+    g_pEventLoop->addPreWaitHook([WATCH]() { rearmDbusWatch(WATCH); });
+}
+
+void CHypridle::dispatchWayland(uint32_t events) {
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        onWaylandDisconnected();
+        return;
+    }
+
+    Debug::log(TRACE, "got wl event");
+    TRACE_SPAN("wl_display_dispatch", "dispatch");
+
+    const auto BEGIN = std::chrono::steady_clock::now();
+
+    if (wl_display_dispatch(m_sWaylandState.display) < 0) {
+        Debug::log(ERR, "[core] Wayland dispatch failed with {}", errno);
+        onWaylandDisconnected();
+        return;
+    }
+
+    g_pMetrics->onDispatch(CMetrics::EVENT_SOURCE_WAYLAND, std::chrono::steady_clock::now() - BEGIN);
+}
+
+void CHypridle::onSignal(int sig) {
+    switch (sig) {
+        case SIGTERM:
+        case SIGINT: g_pEventLoop->terminate(); break;
+        case SIGHUP: reloadConfig(); break;
+        case SIGUSR1:
+            if (g_pTracer)
+                g_pTracer->write();
             break;
+        default: break;
+    }
+}
 
-        m_sEventLoopInternals.shouldProcess = false;
+void CHypridle::updateListeners() {
+    static const auto IGNOREWAYLANDINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_wayland_inhibit");
 
-        std::lock_guard<std::mutex> lg(m_sEventLoopInternals.eventLock);
+    const auto&       RULES = g_pConfigManager->getRules();
 
-        if (pollfds[0].revents & POLLIN /* dbus */) {
-            Debug::log(TRACE, "got dbus event");
-            while (m_sDBUSState.connection->processPendingEvent()) {
-                ;
-            }
+    Debug::log(LOG, "found {} rules for {} seats", RULES.size(), m_sWaylandIdleState.seats.size());
+
+    // the notification type of every group depends on it
+    const bool REARMALL                      = m_sWaylandIdleState.ignoreWaylandInhibit != (bool)*IGNOREWAYLANDINHIBIT;
+    m_sWaylandIdleState.ignoreWaylandInhibit = *IGNOREWAYLANDINHIBIT;
+
+    m_sWaylandIdleState.listeners.clear();
+
+    for (auto& seat : m_sWaylandIdleState.seats) {
+        updateSeatListeners(seat, REARMALL);
+        m_sWaylandIdleState.listeners.insert(m_sWaylandIdleState.listeners.end(), seat->listeners.begin(), seat->listeners.end());
+    }
+}
+
+void CHypridle::updateSeatListeners(const SP<SSeat>& seat, bool rearmAll) {
+    static const auto DERIVEIDLETIERS = g_pConfigManager->getValue<Hyprlang::INT>("general:derive_idle_tiers");
+
+    const auto&       RULES = g_pConfigManager->getRules();
+
+    auto              oldListeners = std::move(seat->listeners);
+    auto              oldGroups    = std::move(seat->groups);
+    size_t            kept         = 0;
+
+    seat->listeners.clear();
+    seat->groups.clear();
+
+    for (const auto& r : RULES) {
+        // rules for a named seat wait for the compositor to tell us the name
+        if (!r.seat.empty() && fnmatch(r.seat.c_str(), seat->name.c_str(), 0) != 0)
+            continue;
+
+        SP<SIdleListener> l;
+
+        // unchanged listeners are carried over with their fired state
+        if (auto old = std::ranges::find_if(oldListeners, [&r](const auto& o) { return o && o->rule == r; }); old != oldListeners.end()) {
+            l = *old;
+            old->reset();
+            ++kept;
+        } else {
+            l       = makeShared<SIdleListener>();
+            l->rule = r;
+            l->seat = seat;
         }
 
-        if (pollfds[1].revents & POLLIN /* wl */) {
-            Debug::log(TRACE, "got wl event");
-            wl_display_flush(m_sWaylandState.display);
-            if (wl_display_prepare_read(m_sWaylandState.display) == 0) {
-                wl_display_read_events(m_sWaylandState.display);
-                wl_display_dispatch_pending(m_sWaylandState.display);
+        seat->listeners.emplace_back(l);
+
+        const auto MATCHES = [&r](const auto& g) { return g && g->timeout == r.timeout && g->ignoreInhibit == r.ignoreInhibit; };
+
+        auto       group = std::ranges::find_if(seat->groups, MATCHES);
+        if (group == seat->groups.end()) {
+            SP<SIdleGroup> g;
+
+            // keep the notification object of groups that still exist
+            if (auto old = std::ranges::find_if(oldGroups, MATCHES); old != oldGroups.end()) {
+                g = *old;
+                old->reset();
+                g->listeners.clear();
             } else {
-                wl_display_dispatch(m_sWaylandState.display);
+                g                = makeShared<SIdleGroup>();
+                g->timeout       = r.timeout;
+                g->ignoreInhibit = r.ignoreInhibit;
+                g->seat          = seat;
             }
+
+            group = seat->groups.insert(seat->groups.end(), g);
         }
 
-        if (pollfdsCount > 2 && pollfds[2].revents & POLLIN /* dbus2 */) {
-            Debug::log(TRACE, "got dbus event");
-            while (m_sDBUSState.screenSaverServiceConnection->processPendingEvent()) {
-                ;
+        (*group)->listeners.emplace_back(l);
+    }
+
+    // whatever is left over is gone from the config
+    for (auto& l : oldListeners) {
+        if (l)
+            cancelPending(l.get());
+    }
+
+    for (auto& g : oldGroups) {
+        if (g && g->notification)
+            g->notification->sendDestroy();
+        if (g && g->derivedTimer)
+            g_pEventLoop->removeTimer(g->derivedTimer);
+    }
+
+    size_t notifications = 0;
+
+    for (auto& g : seat->groups) {
+        const auto OLDBASE = g->base.lock();
+
+        // the shortest timeout of each inhibit class keeps its notification, the longer ones are timed from it
+        SP<SIdleGroup> base;
+        if (*DERIVEIDLETIERS) {
+            for (const auto& other : seat->groups) {
+                if (other->ignoreInhibit == g->ignoreInhibit && other->timeout < g->timeout && (!base || other->timeout < base->timeout))
+                    base = other;
             }
         }
 
-        // finalize wayland dispatching. Dispatch pending on the queue
-        int ret = 0;
-        do {
-            ret = wl_display_dispatch_pending(m_sWaylandState.display);
-            wl_display_flush(m_sWaylandState.display);
-        } while (ret > 0);
+        g->base = base;
+
+        if (!base) {
+            ++notifications;
+            if (!g->notification || rearmAll)
+                armIdleGroup(g.get());
+        } else if (OLDBASE != base || rearmAll)
+            armIdleGroup(g.get());
+    }
+
+    seat->idled = std::ranges::any_of(seat->groups, [](const auto& g) { return g->idled; });
+
+    Debug::log(LOG, "Seat {}: {} rules ({} unchanged) share {} idle notifications, {} tiers derived", seat->name.empty() ? std::string{"(unnamed)"} : seat->name,
+               seat->listeners.size(), kept, notifications, seat->groups.size() - notifications);
+}
+
+void CHypridle::addSeat(uint32_t registryName, uint32_t version) {
+    auto seat          = makeShared<SSeat>();
+    seat->registryName = registryName;
+    seat->seat         = makeShared<CCWlSeat>((wl_proxy*)wl_registry_bind((wl_registry*)m_sWaylandState.registry->resource(), registryName, &wl_seat_interface, version));
+
+    // the name only matters to rules with a seat key, those get armed once it's there
+    seat->seat->setName([this, weak = WP<SSeat>{seat}](CCWlSeat* s, const char* name) {
+        const auto SEAT = weak.lock();
+        if (!SEAT || SEAT->name == name)
+            return;
+
+        Debug::log(LOG, "Seat {} is {}", SEAT->registryName, name);
+        SEAT->name = name;
+
+        if (m_sWaylandState.armed)
+            updateListeners();
+    });
+
+    m_sWaylandIdleState.seats.emplace_back(seat);
+    Debug::log(LOG, "   > Bound to {} v{}, {} seats", wl_seat_interface.name, version, m_sWaylandIdleState.seats.size());
+
+    // at startup, armWayland() arms the listeners once it has all globals. Seats plugged in later get theirs right away.
+    if (m_sWaylandState.armed)
+        updateListeners();
+}
+
+void CHypridle::removeSeat(uint32_t registryName) {
+    const auto SEAT = std::ranges::find_if(m_sWaylandIdleState.seats, [registryName](const auto& s) { return s->registryName == registryName; });
+    if (SEAT == m_sWaylandIdleState.seats.end())
+        return;
+
+    const auto seat = *SEAT;
+    m_sWaylandIdleState.seats.erase(SEAT);
+
+    Debug::log(LOG, "Seat {} ({}) is gone, dropping its {} listeners", seat->name, registryName, seat->listeners.size());
+
+    // its on-resume can't come anymore, commands that are still running are left alone
+    for (auto& l : seat->listeners) {
+        cancelPending(l.get());
+    }
+
+    for (auto& g : seat->groups) {
+        if (g->notification)
+            g->notification->sendDestroy();
+        if (g->derivedTimer)
+            g_pEventLoop->removeTimer(g->derivedTimer);
+    }
+
+    // wl_seat.release is v5, older ones just get their proxy destroyed
+    if (wl_proxy_get_version(seat->seat->resource()) >= 5)
+        seat->seat->sendRelease();
+
+    std::erase_if(m_sWaylandIdleState.listeners, [&seat](const auto& l) { return l->seat.get() == seat.get(); });
+}
+
+void CHypridle::reloadConfig() {
+    if (!g_pConfigManager->reload())
+        return;
+
+    static const auto MAXPROCESSES         = g_pConfigManager->getValue<Hyprlang::INT>("general:max_processes");
+    static const auto IGNOREDBUSINHIBIT    = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_dbus_inhibit");
+    static const auto IGNORESYSTEMDINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_systemd_inhibit");
+
+    g_pExecutor->setMaxProcesses(std::max<Hyprlang::INT>(*MAXPROCESSES, 0));
+
+    updateListeners();
+
+    // take or release the sleep inhibitor for the new inhibit_sleep, the same way startup and lock changes do
+    const auto OLDBEHAVIOR = m_inhibitSleepBehavior;
+    setupSleepInhibitBehavior(!!m_sWaylandState.lockNotifier);
+    if (m_inhibitSleepBehavior != OLDBEHAVIOR) {
+        const bool WANTED = m_inhibitSleepBehavior == SLEEP_INHIBIT_NORMAL || (m_inhibitSleepBehavior == SLEEP_INHIBIT_LOCK_NOTIFY && !m_isLocked);
+        if (WANTED && !sleepInhibitActive())
+            inhibitSleep();
+        else if (!WANTED && sleepInhibitActive())
+            uninhibitSleep();
     }
 
-    Debug::log(ERR, "[core] Terminated");
-}
+    // these decide which bus names and matches we set up at startup
+    if ((bool)*IGNOREDBUSINHIBIT != m_sDBUSState.ignoreDbusInhibit)
+        Debug::log(WARN, "general:ignore_dbus_inhibit changed, restart hypridle for it to take effect");
+    if ((bool)*IGNORESYSTEMDINHIBIT != m_sDBUSState.ignoreSystemdInhibit)
+        Debug::log(WARN, "general:ignore_systemd_inhibit changed, restart hypridle for it to take effect");
+
+    if (g_pConfigWatcher)
+        g_pConfigWatcher->setWatchList(g_pConfigManager->configFiles());
+}
+
+void CHypridle::armIdleGroup(SIdleGroup* group) {
+    if (group->notification)
+        group->notification->sendDestroy();
+
+    if (group->derivedTimer) {
+        g_pEventLoop->removeTimer(group->derivedTimer);
+        group->derivedTimer = 0;
+    }
+
+    if (const auto BASE = group->base.lock()) {
+        group->notification.reset();
+        group->idled      = false;
+        group->missedIdle = false;
+
+        // the base went idle before this tier (re)started counting, so this one needs its full timeout from now
+        if (BASE->idled)
+            startDerivedTimer(group, std::chrono::seconds(group->timeout));
+        return;
+    }
+
+    // the tiers timed from this one start over with it, those that already went idle are resumed so their commands stay paired
+    if (const auto SEAT = group->seat.lock()) {
+        for (auto& g : SEAT->groups) {
+            if (g->base.get() != group)
+                continue;
+
+            if (g->derivedTimer) {
+                g_pEventLoop->removeTimer(g->derivedTimer);
+                g->derivedTimer = 0;
+            }
+
+            if (g->idled)
+                onGroupResumed(g.get());
+        }
+    }
+
+    if (m_sReplayState.active) {
+        // the recording has whatever the compositor sent for the new notification
+        group->idled      = false;
+        group->missedIdle = false;
+        return;
+    }
+
+    // armed once ext-idle-notifier-v1 is back
+    if (!m_sWaylandIdleState.notifier) {
+        group->notification.reset();
+        group->idled      = false;
+        group->missedIdle = false;
+        return;
+    }
+
+    const auto SEAT = group->seat.lock();
+
+    if (m_sWaylandIdleState.ignoreWaylandInhibit || group->ignoreInhibit)
+        group->notification =
+            makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetInputIdleNotification(group->timeout * 1000 /* ms */, SEAT->seat->resource()));
+    else
+        group->notification = makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetIdleNotification(group->timeout * 1000 /* ms */, SEAT->seat->resource()));
+
+    group->idled      = false;
+    group->missedIdle = false;
+
+    group->notification->setData(group);
+
+    group->notification->setIdled([this](CCExtIdleNotificationV1* n) { onGroupIdled((CHypridle::SIdleGroup*)n->data()); });
+    group->notification->setResumed([this](CCExtIdleNotificationV1* n) { onGroupResumed((CHypridle::SIdleGroup*)n->data()); });
+}
+
+void CHypridle::startDerivedTimer(SIdleGroup* group, std::chrono::milliseconds delay) {
+    // groups cancel this in armIdleGroup and when they're dropped from the config, so the pointer outlives the timer
+    group->derivedTimer = g_pEventLoop->addTimer(delay, [this, group]() {
+        group->derivedTimer = 0;
+        onGroupIdled(group);
+    });
+}
+
+void CHypridle::onGroupIdled(SIdleGroup* group) {
+    TRACE_SPAN("onGroupIdled", "handler");
+    m_eventBegin = std::chrono::steady_clock::now();
+
+    // only what the compositor sent, derived tiers follow from it on replay
+    const auto SEAT = group->seat.lock();
+
+    if (g_pEventRecorder && !group->base.lock())
+        g_pEventRecorder->record(CEventRecorder::EVENT_IDLED, group->timeout, group->ignoreInhibit, {SEAT->name});
+
+    group->idled      = true;
+    group->missedIdle = m_iInhibitLocks > 0 && !group->ignoreInhibit;
+    SEAT->idled       = true;
+
+    for (const auto& l : group->listeners) {
+        if (const auto LISTENER = l.lock())
+            onIdled(LISTENER.get());
+    }
+
+    for (auto& g : SEAT->groups) {
+        if (g->base.get() == group && !g->idled && !g->derivedTimer)
+            startDerivedTimer(g.get(), std::chrono::seconds(g->timeout - group->timeout));
+    }
+}
+
+void CHypridle::onGroupResumed(SIdleGroup* group) {
+    TRACE_SPAN("onGroupResumed", "handler");
+    m_eventBegin = std::chrono::steady_clock::now();
+
+    const auto SEAT = group->seat.lock();
+
+    if (g_pEventRecorder && !group->base.lock())
+        g_pEventRecorder->record(CEventRecorder::EVENT_RESUMED, group->timeout, group->ignoreInhibit, {SEAT->name});
+
+    group->idled      = false;
+    group->missedIdle = false;
+    SEAT->idled       = false;
+
+    for (const auto& l : group->listeners) {
+        if (const auto LISTENER = l.lock())
+            onResumed(LISTENER.get());
+    }
+
+    // any input resumes every tier, longer ones included
+    for (auto& g : SEAT->groups) {
+        if (g->base.get() != group)
+            continue;
+
+        if (g->derivedTimer) {
+            g_pEventLoop->removeTimer(g->derivedTimer);
+            g->derivedTimer = 0;
+        }
+
+        if (g->idled)
+            onGroupResumed(g.get());
+    }
+}
+
+void CHypridle::onIdled(SIdleListener* pListener) {
+    TRACE_SPAN("onIdled", "handler", pListener->rule.onTimeout);
+    Debug::log(LOG, "Idled: rule {:x}", (uintptr_t)pListener);
+    pListener->idledCount++;
+
+    // a short burst of activity: on-timeout is still in effect, so neither command has to run
+    if (pListener->pendingResume || pListener->settleNotification) {
+        Debug::log(LOG, "Idled again while on-resume was held, dropping it for rule {:x}", (uintptr_t)pListener);
+        if (pListener->pendingResume)
+            g_pEventLoop->removeTimer(pListener->pendingResume);
+        pListener->pendingResume = 0;
+        dropResumeSettle(pListener);
+        return;
+    }
+
+    if (g_pHypridle->m_iInhibitLocks > 0 && !pListener->rule.ignoreInhibit) {
+        Debug::log(LOG, "Ignoring from onIdled(), inhibit locks: {}", g_pHypridle->m_iInhibitLocks);
+        return;
+    }
+
+    if (pListener->rule.onTimeout.empty()) {
+        Debug::log(LOG, "Ignoring, onTimeout is empty.");
+        return;
+    }
+
+    if (pListener->rule.minIdleMs > 0) {
+        if (!pListener->pendingTimeout) {
+            Debug::log(LOG, "Holding on-timeout for rule {:x} for {}ms", (uintptr_t)pListener, pListener->rule.minIdleMs);
+            pListener->pendingTimeout = g_pEventLoop->addTimer(std::chrono::milliseconds(pListener->rule.minIdleMs), [this, pListener]() {
+                pListener->pendingTimeout = 0;
+                m_eventBegin              = std::chrono::steady_clock::now();
+                runOnTimeout(pListener);
+            });
+        }
+        return;
+    }
+
+    runOnTimeout(pListener);
+}
+
+void CHypridle::onResumed(SIdleListener* pListener) {
+    TRACE_SPAN("onResumed", "handler", pListener->rule.onResume);
+    Debug::log(LOG, "Resumed: rule {:x}", (uintptr_t)pListener);
+    pListener->resumedCount++;
+
+    if (pListener->pendingTimeout) {
+        Debug::log(LOG, "Resumed within min_idle_ms, on-timeout never ran for rule {:x}", (uintptr_t)pListener);
+        g_pEventLoop->removeTimer(pListener->pendingTimeout);
+        pListener->pendingTimeout = 0;
+        return;
+    }
+
+    // If on-timeout never actually executed (was inhibited), skip on-resume too
+    if (!pListener->onTimeoutFired) {
+        Debug::log(LOG, "Skipping onResumed: onTimeout was inhibited for rule {:x}", (uintptr_t)pListener);
+        return;
+    }
+
+    if (pListener->rule.resumeGraceMs > 0) {
+        if (!pListener->pendingResume && !pListener->settleNotification) {
+            Debug::log(LOG, "Holding on-resume for rule {:x} for {}ms", (uintptr_t)pListener, pListener->rule.resumeGraceMs);
+            pListener->pendingResume = g_pEventLoop->addTimer(std::chrono::milliseconds(pListener->rule.resumeGraceMs), [this, pListener]() {
+                pListener->pendingResume = 0;
+                dropResumeSettle(pListener);
+                m_eventBegin = std::chrono::steady_clock::now();
+                runOnResume(pListener);
+            });
+            armResumeSettle(pListener);
+        }
+        return;
+    }
+
+    runOnResume(pListener);
+}
+
+void CHypridle::runOnTimeout(SIdleListener* pListener) {
+    Debug::log(LOG, "Running {}", pListener->rule.onTimeout);
+    pListener->onTimeoutFired = true;
+    queueAction(pListener, pListener->rule.onTimeout, CMetrics::ACTION_IDLE_TO_TIMEOUT_CMD);
+}
+
+void CHypridle::runOnResume(SIdleListener* pListener) {
+    pListener->onTimeoutFired = false;
+
+    if (pListener->rule.cancelOnResume) {
+        if (const auto PROCESS = pListener->timeoutProcess.lock(); PROCESS && !PROCESS->exited) {
+            Debug::log(LOG, "Cancelling on-timeout that is still running for rule {:x}", (uintptr_t)pListener);
+            g_pExecutor->cancel(PROCESS);
+        }
+
+        // still waiting for the commands it is ordered after
+        for (const auto& graph : m_runningActions) {
+            graph->cancel(pListener);
+        }
+        if (m_pendingActions)
+            m_pendingActions->cancel(pListener);
+    }
+
+    pListener->timeoutProcess.reset();
+
+    if (pListener->rule.onResume.empty()) {
+        Debug::log(LOG, "Ignoring, onRestore is empty.");
+        return;
+    }
+
+    Debug::log(LOG, "Running {}", pListener->rule.onResume);
+    queueAction(pListener, pListener->rule.onResume, CMetrics::ACTION_RESUME_TO_RESUME_CMD);
+}
+
+void CHypridle::queueAction(SIdleListener* pListener, const std::string& command, CMetrics::eAction action) {
+    static const auto CONCURRENCY = g_pConfigManager->getValue<Hyprlang::INT>("general:action_concurrency");
+
+    if (!m_pendingActions)
+        m_pendingActions = makeShared<CActionGraph>(std::max<Hyprlang::INT>(*CONCURRENCY, 0));
+
+    // ids only order the commands of one seat, every seat has listeners of its own for the same rules
+    const auto SEAT  = pListener->seat.lock();
+    const auto SCOPE = [&SEAT](const std::string& id) { return std::format("{}/{}", SEAT ? SEAT->registryName : 0, id); };
+
+    std::vector<std::string> after;
+    for (const auto& dep : pListener->rule.after) {
+        after.emplace_back(SCOPE(dep));
+    }
+
+    // latency up to the actual spawn, waiting for the commands it is ordered after included
+    const auto BEGIN = m_eventBegin;
+    m_pendingActions->add(pListener, SCOPE(pListener->rule.id), after, command, {.deadline = std::chrono::seconds(pListener->rule.deadline)},
+                          [pListener, action, BEGIN](SP<CExecutor::SProcess> process) {
+                              if (action == CMetrics::ACTION_IDLE_TO_TIMEOUT_CMD)
+                                  pListener->timeoutProcess = process;
+                              g_pMetrics->onAction(action, std::chrono::steady_clock::now() - BEGIN);
+                          });
+}
+
+void CHypridle::flushActions() {
+    std::erase_if(m_runningActions, [](const auto& graph) { return graph->done(); });
+
+    if (!m_pendingActions)
+        return;
+
+    // run() might add to m_pendingActions through a dry run, that goes into the next graph
+    auto graph = m_pendingActions;
+    m_pendingActions.reset();
+
+    m_runningActions.emplace_back(graph);
+    graph->run();
+}
+
+void CHypridle::cancelPending(SIdleListener* pListener) {
+    if (pListener->pendingTimeout)
+        g_pEventLoop->removeTimer(pListener->pendingTimeout);
+    if (pListener->pendingResume)
+        g_pEventLoop->removeTimer(pListener->pendingResume);
+
+    pListener->pendingTimeout = 0;
+    pListener->pendingResume  = 0;
+    dropResumeSettle(pListener);
+
+    // the graphs hold on to the listener until its commands started
+    for (const auto& graph : m_runningActions) {
+        graph->cancel(pListener);
+    }
+    if (m_pendingActions)
+        m_pendingActions->cancel(pListener);
+}
+
+void CHypridle::armResumeSettle(SIdleListener* pListener) {
+    const auto SEAT = pListener->seat.lock();
+
+    // input-only notifications are v2. Without one (or on replay) the grace is a plain delay.
+    if (!SEAT || !SEAT->seat || !m_sWaylandIdleState.notifier || wl_proxy_get_version(m_sWaylandIdleState.notifier->resource()) < 2)
+        return;
+
+    // the compositor only re-sends idled after the full timeout, this notices the input stopping again within the grace
+    const auto SETTLEMS = (uint32_t)std::clamp<uint64_t>(pListener->rule.resumeGraceMs / 2, 1, UINT32_MAX);
+    pListener->settleNotification =
+        makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetInputIdleNotification(SETTLEMS, SEAT->seat->resource()));
+
+    // no input for half the grace right after resuming: a blip. on-timeout stays in effect until input comes back.
+    pListener->settleNotification->setIdled([pListener](CCExtIdleNotificationV1* n) {
+        if (!pListener->pendingResume)
+            return;
+
+        Debug::log(LOG, "Input stopped again within resume_grace_ms, holding on-resume for rule {:x} until the next input", (uintptr_t)pListener);
+        g_pEventLoop->removeTimer(pListener->pendingResume);
+        pListener->pendingResume = 0;
+    });
+
+    pListener->settleNotification->setResumed([this, pListener](CCExtIdleNotificationV1* n) {
+        m_eventBegin = std::chrono::steady_clock::now();
+        runOnResume(pListener);
 
-static void spawn(const std::string& args) {
-    Debug::log(LOG, "Executing {}", args);
+        // last, this destroys the notification we're called from
+        dropResumeSettle(pListener);
+    });
+}
 
-    Hyprutils::OS::CProcess proc("/bin/sh", {"-c", args});
-    if (!proc.runAsync()) {
-        Debug::log(ERR, "Failed run \"{}\"", args);
+void CHypridle::dropResumeSettle(SIdleListener* pListener) {
+    if (!pListener->settleNotification)
         return;
-    }
 
-    Debug::log(LOG, "Process Created with pid {}", proc.pid());
+    pListener->settleNotification->sendDestroy();
+    pListener->settleNotification.reset();
 }
 
-void CHypridle::onIdled(SIdleListener* pListener) {
-    Debug::log(LOG, "Idled: rule {:x}", (uintptr_t)pListener);
-    isIdled = true;
-    if (g_pHypridle->m_iInhibitLocks > 0 && !pListener->ignoreInhibit) {
-        Debug::log(LOG, "Ignoring from onIdled(), inhibit locks: {}", g_pHypridle->m_iInhibitLocks);
-        return;
+void CHypridle::onInhibit(bool lock, int64_t count) {
+    TRACE_SPAN(lock ? "onInhibit(true)" : "onInhibit(false)", "handler");
+    const bool WASINHIBITED = m_iInhibitLocks > 0;
+    m_iInhibitLocks += lock ? count : -count;
+
+    if (m_iInhibitLocks < 0) {
+        Debug::log(WARN, "BUG THIS: inhibit locks < 0: {}", m_iInhibitLocks);
+        m_iInhibitLocks = 0;
     }
 
-    if (pListener->onTimeout.empty()) {
-        Debug::log(LOG, "Ignoring, onTimeout is empty.");
-        return;
+    if (m_iInhibitLocks == 0) {
+        // only groups that went idle while inhibited need a fresh notification, everything else already fired or is still counting
+        for (auto& seat : m_sWaylandIdleState.seats) {
+            if (!seat->idled)
+                continue;
+
+            for (auto& g : seat->groups) {
+                if (g->idled && g->missedIdle)
+                    armIdleGroup(g.get());
+            }
+        }
     }
 
-    Debug::log(LOG, "Running {}", pListener->onTimeout);
-    pListener->onTimeoutFired = true;
-    spawn(pListener->onTimeout);
+    // inhibitor storms would flood the log otherwise
+    Debug::log(WASINHIBITED != (m_iInhibitLocks > 0) ? LOG : TRACE, "Inhibit locks: {}", m_iInhibitLocks);
 }
 
-void CHypridle::onResumed(SIdleListener* pListener) {
-    Debug::log(LOG, "Resumed: rule {:x}", (uintptr_t)pListener);
-    isIdled = false;
+int64_t CHypridle::inhibitLocks() const {
+    return m_iInhibitLocks;
+}
 
-    // If on-timeout never actually executed (was inhibited), skip on-resume too
-    if (!pListener->onTimeoutFired) {
-        Debug::log(LOG, "Skipping onResumed: onTimeout was inhibited for rule {:x}", (uintptr_t)pListener);
-        return;
-    }
+bool CHypridle::isIdle() const {
+    return std::ranges::any_of(m_sWaylandIdleState.seats, [](const auto& s) { return s->idled; });
+}
 
-    pListener->onTimeoutFired = false;
+bool CHypridle::isLocked() const {
+    return m_isLocked;
+}
 
-    if (pListener->onRestore.empty()) {
-        Debug::log(LOG, "Ignoring, onRestore is empty.");
-        return;
-    }
+const std::vector<SP<CHypridle::SSeat>>& CHypridle::getSeats() const {
+    return m_sWaylandIdleState.seats;
+}
 
-    Debug::log(LOG, "Running {}", pListener->onRestore);
-    spawn(pListener->onRestore);
+const std::vector<SP<CHypridle::SIdleListener>>& CHypridle::getListeners() const {
+    return m_sWaylandIdleState.listeners;
 }
 
-void CHypridle::onInhibit(bool lock) {
-    m_iInhibitLocks += lock ? 1 : -1;
+bool CHypridle::fireListener(size_t index) {
+    if (index >= m_sWaylandIdleState.listeners.size())
+        return false;
 
-    if (m_iInhibitLocks < 0) {
-        Debug::log(WARN, "BUG THIS: inhibit locks < 0: {}", m_iInhibitLocks);
-        m_iInhibitLocks = 0;
-    }
+    const auto& l = m_sWaylandIdleState.listeners[index];
+    Debug::log(LOG, "Firing listener {} (timeout {}) on request", index, l->rule.timeout);
 
-    if (m_iInhibitLocks == 0 && isIdled) {
-        static const auto IGNOREWAYLANDINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_wayland_inhibit");
+    if (l->rule.onTimeout.empty())
+        return true;
 
-        const auto        RULES = g_pConfigManager->getRules();
-        for (size_t i = 0; i < RULES.size(); ++i) {
-            auto&       l = m_sWaylandIdleState.listeners[i];
-            const auto& r = RULES[i];
+    cancelPending(l.get());
 
-            l.notification->sendDestroy();
+    // queued like an idle event, so concurrency limits, ordering and the latency metrics apply. The graph runs before the loop waits again.
+    m_eventBegin = std::chrono::steady_clock::now();
+    runOnTimeout(l.get());
+    return true;
+}
 
-            if (*IGNOREWAYLANDINHIBIT || r.ignoreInhibit)
-                l.notification =
-                    makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetInputIdleNotification(r.timeout * 1000 /* ms */, m_sWaylandState.seat->resource()));
-            else
-                l.notification =
-                    makeShared<CCExtIdleNotificationV1>(m_sWaylandIdleState.notifier->sendGetIdleNotification(r.timeout * 1000 /* ms */, m_sWaylandState.seat->resource()));
+bool CHypridle::resetListener(size_t index) {
+    if (index >= m_sWaylandIdleState.listeners.size())
+        return false;
 
-            l.notification->setData(&m_sWaylandIdleState.listeners[i]);
+    Debug::log(LOG, "Resetting listener {} on request", index);
 
-            l.notification->setIdled([this](CCExtIdleNotificationV1* n) { onIdled((CHypridle::SIdleListener*)n->data()); });
-            l.notification->setResumed([this](CCExtIdleNotificationV1* n) { onResumed((CHypridle::SIdleListener*)n->data()); });
-        }
-    }
+    cancelPending(m_sWaylandIdleState.listeners[index].get());
 
-    Debug::log(LOG, "Inhibit locks: {}", m_iInhibitLocks);
+    m_sWaylandIdleState.listeners[index]->onTimeoutFired = false;
+    m_sWaylandIdleState.listeners[index]->timeoutProcess.reset();
+    return true;
 }
 
 void CHypridle::onLocked() {
+    TRACE_SPAN("onLocked", "handler");
+
+    if (g_pEventRecorder)
+        g_pEventRecorder->record(CEventRecorder::EVENT_LOCKED);
+
     Debug::log(LOG, "Wayland session got locked");
     m_isLocked = true;
 
     static const auto LOCKCMD = g_pConfigManager->getValue<Hyprlang::STRING>("general:on_lock_cmd");
     if (!std::string{*LOCKCMD}.empty())
-        spawn(*LOCKCMD);
+        g_pExecutor->spawn(*LOCKCMD);
 
     if (m_inhibitSleepBehavior == SLEEP_INHIBIT_LOCK_NOTIFY)
         uninhibitSleep();
+
+    if (m_sDBUSState.sleepLockWaitTimer) {
+        g_pEventLoop->removeTimer(m_sDBUSState.sleepLockWaitTimer);
+        m_sDBUSState.sleepLockWaitTimer = 0;
+        uninhibitSleep();
+    }
 }
 
 void CHypridle::onUnlocked() {
+    TRACE_SPAN("onUnlocked", "handler");
+
+    if (g_pEventRecorder)
+        g_pEventRecorder->record(CEventRecorder::EVENT_UNLOCKED);
+
     Debug::log(LOG, "Wayland session got unlocked");
     m_isLocked = false;
 
@@ -350,69 +1157,54 @@ void CHypridle::onUnlocked() {
 
     static const auto UNLOCKCMD = g_pConfigManager->getValue<Hyprlang::STRING>("general:on_unlock_cmd");
     if (!std::string{*UNLOCKCMD}.empty())
-        spawn(*UNLOCKCMD);
-}
-
-CHypridle::SDbusInhibitCookie CHypridle::getDbusInhibitCookie(uint32_t cookie) {
-    for (auto& c : m_sDBUSState.inhibitCookies) {
-        if (c.cookie == cookie)
-            return c;
-    }
-
-    return {};
-}
-
-void CHypridle::registerDbusInhibitCookie(CHypridle::SDbusInhibitCookie& cookie) {
-    m_sDBUSState.inhibitCookies.push_back(cookie);
-}
-
-bool CHypridle::unregisterDbusInhibitCookie(const CHypridle::SDbusInhibitCookie& cookie) {
-    const auto IT = std::ranges::find_if(m_sDBUSState.inhibitCookies, [&cookie](const CHypridle::SDbusInhibitCookie& item) { return item.cookie == cookie.cookie; });
-
-    if (IT == m_sDBUSState.inhibitCookies.end())
-        return false;
-
-    m_sDBUSState.inhibitCookies.erase(IT);
-    return true;
+        g_pExecutor->spawn(*UNLOCKCMD);
 }
 
-size_t CHypridle::unregisterDbusInhibitCookies(const std::string& ownerID) {
-    return std::erase_if(m_sDBUSState.inhibitCookies, [&ownerID](const CHypridle::SDbusInhibitCookie& item) { return item.ownerID == ownerID; });
+CDbusInhibitRegistry& CHypridle::getDbusInhibitCookies() {
+    return m_sDBUSState.inhibitCookies;
 }
 
-static void handleDbusLogin(sdbus::Message msg) {
+static void handleSessionLockRequest(const std::string& MEMBER) {
     // lock & unlock
     static const auto LOCKCMD   = g_pConfigManager->getValue<Hyprlang::STRING>("general:lock_cmd");
     static const auto UNLOCKCMD = g_pConfigManager->getValue<Hyprlang::STRING>("general:unlock_cmd");
 
-    Debug::log(LOG, "Got dbus .Session");
+    TRACE_SPAN("handleDbusLogin", "handler", MEMBER);
 
-    const std::string MEMBER = msg.getMemberName();
     if (MEMBER == "Lock") {
         Debug::log(LOG, "Got Lock from dbus");
 
+        if (g_pEventRecorder)
+            g_pEventRecorder->record(CEventRecorder::EVENT_SESSION_LOCK);
+
         if (!std::string{*LOCKCMD}.empty()) {
             Debug::log(LOG, "Locking with {}", *LOCKCMD);
-            spawn(*LOCKCMD);
+            g_pExecutor->spawn(*LOCKCMD);
         }
     } else if (MEMBER == "Unlock") {
         Debug::log(LOG, "Got Unlock from dbus");
 
+        if (g_pEventRecorder)
+            g_pEventRecorder->record(CEventRecorder::EVENT_SESSION_UNLOCK);
+
         if (!std::string{*UNLOCKCMD}.empty()) {
             Debug::log(LOG, "Unlocking with {}", *UNLOCKCMD);
-            spawn(*UNLOCKCMD);
+            g_pExecutor->spawn(*UNLOCKCMD);
         }
     }
 }
 
-static void handleDbusSleep(sdbus::Message msg) {
-    const std::string MEMBER = msg.getMemberName();
+static void handleDbusLogin(sdbus::Message msg) {
+    Debug::log(LOG, "Got dbus .Session");
+    handleSessionLockRequest(msg.getMemberName());
+}
 
-    if (MEMBER != "PrepareForSleep")
-        return;
+static void handlePrepareForSleep(bool toSleep) {
+    if (g_pEventRecorder)
+        g_pEventRecorder->record(CEventRecorder::EVENT_PREPARE_FOR_SLEEP, toSleep);
 
-    bool toSleep = true;
-    msg >> toSleep;
+    TRACE_SPAN("handleDbusSleep", "handler", toSleep ? "PrepareForSleep(true)" : "PrepareForSleep(false)");
+    g_pMetrics->onPrepareForSleep(toSleep);
 
     static const auto SLEEPCMD      = g_pConfigManager->getValue<Hyprlang::STRING>("general:before_sleep_cmd");
     static const auto AFTERSLEEPCMD = g_pConfigManager->getValue<Hyprlang::STRING>("general:after_sleep_cmd");
@@ -424,25 +1216,89 @@ static void handleDbusSleep(sdbus::Message msg) {
     if (!toSleep)
         g_pHypridle->handleInhibitOnDbusSleep(toSleep);
 
-    if (!cmd.empty())
-        spawn(cmd);
-
-    if (toSleep)
+    // a built-in before_sleep_cmd replies quickly, so the sleep inhibitor is held until it did. With logind:lock-session,
+    // the Lock signal (and lock_cmd) is handled before the reply, instead of racing the suspend like a spawned loginctl does,
+    // and the inhibitor is kept until the locker actually locked.
+    const auto              ACTION = CConfigManager::parseAction(cmd);
+    const bool              WAIT   = toSleep && ACTION && ACTION->type != CConfigManager::SAction::ACTION_COMMAND;
+    const bool              LOCK   = WAIT && ACTION->type == CConfigManager::SAction::ACTION_LOGIND && ACTION->verb == "lock-session";
+
+    SP<CExecutor::SProcess> process;
+    if (LOCK)
+        process = g_pExecutor->spawn(cmd, {.onExit = []() { g_pHypridle->releaseSleepOnLock(); }});
+    else if (WAIT)
+        process = g_pExecutor->spawn(cmd, {.onExit = []() { g_pHypridle->handleInhibitOnDbusSleep(true); }});
+    else if (!cmd.empty())
+        process = g_pExecutor->spawn(cmd);
+
+    if (toSleep && !(WAIT && process))
         g_pHypridle->handleInhibitOnDbusSleep(toSleep);
 }
 
+static void handleDbusSleep(sdbus::Message msg) {
+    const std::string MEMBER = msg.getMemberName();
+
+    if (MEMBER != "PrepareForSleep")
+        return;
+
+    bool toSleep = true;
+    msg >> toSleep;
+
+    handlePrepareForSleep(toSleep);
+}
+
+static bool systemdIdleInhibited = false;
+
+// ScreenSaver calls come in bursts (browsers inhibit per tab), so only the first call of a burst is logged and the rest is summed up
+constexpr std::chrono::milliseconds SCREENSAVER_SUMMARY_INTERVAL = std::chrono::milliseconds{1000};
+
+static struct {
+    uint64_t inhibits   = 0;
+    uint64_t uninhibits = 0;
+    uint64_t ownersLost = 0;
+    uint64_t timer      = 0;
+} screenSaverBurst;
+
+static void onScreenSaverBurstEnd() {
+    screenSaverBurst.timer = 0;
+
+    if (screenSaverBurst.inhibits + screenSaverBurst.uninhibits + screenSaverBurst.ownersLost > 0)
+        Debug::log(LOG, "ScreenSaver: {} more Inhibit, {} UnInhibit and {} disconnected owners in the last {}ms, {} cookies active", screenSaverBurst.inhibits,
+                   screenSaverBurst.uninhibits, screenSaverBurst.ownersLost, SCREENSAVER_SUMMARY_INTERVAL.count(), g_pHypridle->getDbusInhibitCookies().size());
+
+    screenSaverBurst.inhibits   = 0;
+    screenSaverBurst.uninhibits = 0;
+    screenSaverBurst.ownersLost = 0;
+}
+
+// returns whether this call should be logged in full
+static bool noteScreenSaverCall(uint64_t& counter) {
+    if (screenSaverBurst.timer) {
+        counter++;
+        return false;
+    }
+
+    screenSaverBurst.timer = g_pEventLoop->addTimer(SCREENSAVER_SUMMARY_INTERVAL, ::onScreenSaverBurstEnd);
+    return true;
+}
+
 static void handleDbusBlockInhibits(const std::string& inhibits) {
-    static auto inhibited = false;
+    TRACE_SPAN("handleDbusBlockInhibits", "handler", inhibits);
+
+    if (g_pEventRecorder)
+        g_pEventRecorder->record(CEventRecorder::EVENT_BLOCK_INHIBITED, 0, 0, {inhibits});
+
     // BlockInhibited is a colon separated list of inhibit types. Wrapping in additional colons allows for easier checking if there are active inhibits we are interested in
     auto inhibits_ = ":" + inhibits + ":";
     if (inhibits_.contains(":idle:")) {
-        if (!inhibited) {
-            inhibited = true;
+        if (!systemdIdleInhibited) {
+            systemdIdleInhibited = true;
             Debug::log(LOG, "systemd idle inhibit active");
+            g_pMetrics->onInhibit(CMetrics::INHIBIT_SOURCE_SYSTEMD);
             g_pHypridle->onInhibit(true);
         }
-    } else if (inhibited) {
-        inhibited = false;
+    } else if (systemdIdleInhibited) {
+        systemdIdleInhibited = false;
         Debug::log(LOG, "systemd idle inhibit inactive");
         g_pHypridle->onInhibit(false);
     }
@@ -458,40 +1314,49 @@ static void handleDbusBlockInhibitsPropertyChanged(sdbus::Message msg) {
 }
 
 static uint32_t handleDbusScreensaver(std::string app, std::string reason, uint32_t cookie, bool inhibit, const char* sender) {
-    std::string ownerID = sender;
-    bool cookieFound = false;
+    auto&       cookies     = g_pHypridle->getDbusInhibitCookies();
+    std::string ownerID     = sender;
+    bool        cookieFound = false;
+
+    TRACE_SPAN(inhibit ? "ScreenSaver.Inhibit" : "ScreenSaver.UnInhibit", "handler", sender);
 
     if (!inhibit) {
         Debug::log(TRACE, "Read uninhibit cookie: {}", cookie);
-        const auto COOKIE = g_pHypridle->getDbusInhibitCookie(cookie);
-        if (COOKIE.cookie == 0) {
+        const auto COOKIE = cookies.get(cookie);
+        if (!COOKIE) {
             Debug::log(WARN, "No cookie in uninhibit");
         } else {
-            app     = COOKIE.app;
-            reason  = COOKIE.reason;
-            ownerID = COOKIE.ownerID;
+            app         = *COOKIE->app;
+            reason      = *COOKIE->reason;
+            ownerID     = *COOKIE->ownerID;
             cookieFound = true;
 
-            if (!g_pHypridle->unregisterDbusInhibitCookie(COOKIE))
-                Debug::log(WARN, "BUG THIS: attempted to unregister unknown cookie");
+            cookies.remove(cookie);
         }
     }
 
-    Debug::log(LOG, "ScreenSaver inhibit: {} dbus message from {} (owner: {}) with content {}", inhibit, app, ownerID, reason);
+    Debug::log(noteScreenSaverCall(inhibit ? screenSaverBurst.inhibits : screenSaverBurst.uninhibits) ? LOG : TRACE,
+               "ScreenSaver inhibit: {} dbus message from {} (owner: {}) with content {}", inhibit, app, ownerID, reason);
 
-    if (inhibit)
+    if (inhibit) {
+        g_pMetrics->onInhibit(CMetrics::INHIBIT_SOURCE_SCREENSAVER);
         g_pHypridle->onInhibit(true);
-    else if (cookieFound)
+    } else if (cookieFound)
         g_pHypridle->onInhibit(false);
 
     static uint32_t cookieID = 1337;
 
-    if (inhibit) {
-        auto cookie = CHypridle::SDbusInhibitCookie{.cookie = cookieID, .app = app, .reason = reason, .ownerID = ownerID};
+    if (g_pEventRecorder) {
+        if (inhibit)
+            g_pEventRecorder->record(CEventRecorder::EVENT_SCREENSAVER_INHIBIT, cookieID, 0, {app, reason, ownerID});
+        else
+            g_pEventRecorder->record(CEventRecorder::EVENT_SCREENSAVER_UNINHIBIT, cookie, 0, {sender});
+    }
 
-        Debug::log(LOG, "Cookie {} sent", cookieID);
+    if (inhibit) {
+        Debug::log(TRACE, "Cookie {} sent", cookieID);
 
-        g_pHypridle->registerDbusInhibitCookie(cookie);
+        cookies.add(cookieID, app, reason, ownerID);
 
         return cookieID++;
     }
@@ -499,6 +1364,21 @@ static uint32_t handleDbusScreensaver(std::string app, std::string reason, uint3
     return 0;
 }
 
+static void handleOwnerLost(const std::string& oldOwner) {
+    TRACE_SPAN("handleDbusNameOwnerChanged", "handler", oldOwner);
+
+    // only owners holding cookies are indexed, everything else is a single hash lookup
+    size_t removed = g_pHypridle->getDbusInhibitCookies().removeOwner(oldOwner);
+    if (removed > 0) {
+        Debug::log(noteScreenSaverCall(screenSaverBurst.ownersLost) ? LOG : TRACE, "App with owner {} disconnected, dropped {} cookies", oldOwner, removed);
+
+        if (g_pEventRecorder)
+            g_pEventRecorder->record(CEventRecorder::EVENT_OWNER_LOST, 0, 0, {oldOwner});
+
+        g_pHypridle->onInhibit(false, removed);
+    }
+}
+
 static void handleDbusNameOwnerChanged(sdbus::Message msg) {
     std::string name, oldOwner, newOwner;
     msg >> name >> oldOwner >> newOwner;
@@ -506,79 +1386,171 @@ static void handleDbusNameOwnerChanged(sdbus::Message msg) {
     if (!newOwner.empty())
         return;
 
-    size_t removed = g_pHypridle->unregisterDbusInhibitCookies(oldOwner);
-    if (removed > 0) {
-        Debug::log(LOG, "App with owner {} disconnected", oldOwner);
-        for (size_t i = 0; i < removed; i++)
-            g_pHypridle->onInhibit(false);
-    }
+    handleOwnerLost(oldOwner);
 }
 
 void CHypridle::setupDBUS() {
-    static const auto IGNOREDBUSINHIBIT    = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_dbus_inhibit");
     static const auto IGNORESYSTEMDINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_systemd_inhibit");
 
-    auto              systemConnection = sdbus::createSystemBusConnection();
-    auto              proxy            = sdbus::createProxy(*systemConnection, sdbus::ServiceName{"org.freedesktop.login1"}, sdbus::ObjectPath{"/org/freedesktop/login1"});
-    sdbus::ObjectPath path;
+    m_sDBUSState.ignoreSystemdInhibit = *IGNORESYSTEMDINHIBIT;
+
+    m_sDBUSState.login = sdbus::createProxy(*m_sDBUSState.connection, sdbus::ServiceName{"org.freedesktop.login1"}, sdbus::ObjectPath{"/org/freedesktop/login1"});
+    m_sDBUSState.connection->addMatch("type='signal',path='/org/freedesktop/login1',interface='org.freedesktop.login1.Manager'", ::handleDbusSleep);
 
+    // everything below is answered once the event loop runs, nothing here waits for logind
     try {
-        proxy->callMethod("GetSession").onInterface("org.freedesktop.login1.Manager").withArguments(std::string{"auto"}).storeResultsTo(path);
+        m_sDBUSState.login->callMethodAsync("GetSession")
+            .onInterface("org.freedesktop.login1.Manager")
+            .withArguments(std::string{"auto"})
+            .uponReplyInvoke([this](std::optional<sdbus::Error> error, sdbus::ObjectPath path) {
+                if (error) {
+                    Debug::log(WARN, "Couldn't connect to logind service ({})", error->what());
+                    return;
+                }
 
-        m_sDBUSState.connection->addMatch("type='signal',path='" + path + "',interface='org.freedesktop.login1.Session'", ::handleDbusLogin);
-        m_sDBUSState.connection->addMatch("type='signal',path='/org/freedesktop/login1',interface='org.freedesktop.login1.Manager'", ::handleDbusSleep);
-        m_sDBUSState.login = sdbus::createProxy(*m_sDBUSState.connection, sdbus::ServiceName{"org.freedesktop.login1"}, sdbus::ObjectPath{"/org/freedesktop/login1"});
-    } catch (std::exception& e) { Debug::log(WARN, "Couldn't connect to logind service ({})", e.what()); }
+                Debug::log(LOG, "Using dbus path {}", path.c_str());
 
-    Debug::log(LOG, "Using dbus path {}", path.c_str());
+                m_sDBUSState.connection->addMatch("type='signal',path='" + path + "',interface='org.freedesktop.login1.Session'", ::handleDbusLogin);
+                m_sDBUSState.session = sdbus::createProxy(*m_sDBUSState.connection, sdbus::ServiceName{"org.freedesktop.login1"}, path);
+            });
+    } catch (std::exception& e) { Debug::log(WARN, "Couldn't connect to logind service ({})", e.what()); }
 
     if (!*IGNORESYSTEMDINHIBIT) {
         m_sDBUSState.connection->addMatch("type='signal',path='/org/freedesktop/login1',interface='org.freedesktop.DBus.Properties'", ::handleDbusBlockInhibitsPropertyChanged);
 
         try {
-            std::string value = (proxy->getProperty("BlockInhibited").onInterface("org.freedesktop.login1.Manager")).get<std::string>();
-            handleDbusBlockInhibits(value);
+            m_sDBUSState.login->getPropertyAsync("BlockInhibited")
+                .onInterface("org.freedesktop.login1.Manager")
+                .uponReplyInvoke([](std::optional<sdbus::Error> error, sdbus::Variant value) {
+                    if (error) {
+                        Debug::log(WARN, "Couldn't retrieve current systemd inhibits ({})", error->what());
+                        return;
+                    }
+
+                    handleDbusBlockInhibits(value.get<std::string>());
+                });
         } catch (std::exception& e) { Debug::log(WARN, "Couldn't retrieve current systemd inhibits ({})", e.what()); }
     }
+}
 
-    if (!*IGNOREDBUSINHIBIT) {
-        // attempt to register as ScreenSaver
-        std::string paths[] = {
-            "/org/freedesktop/ScreenSaver",
-            "/ScreenSaver",
-        };
+void CHypridle::setupScreenSaver() {
+    static const auto IGNOREDBUSINHIBIT = g_pConfigManager->getValue<Hyprlang::INT>("general:ignore_dbus_inhibit");
 
-        try {
-            m_sDBUSState.screenSaverServiceConnection = sdbus::createSessionBusConnection(sdbus::ServiceName{"org.freedesktop.ScreenSaver"});
-
-            for (const std::string& path : paths) {
-                try {
-                    auto obj = sdbus::createObject(*m_sDBUSState.screenSaverServiceConnection, sdbus::ObjectPath{path});
-
-                    obj->addVTable(sdbus::registerMethod("Inhibit").implementedAs([object = obj.get()](std::string s1, std::string s2) {
-                           return handleDbusScreensaver(s1, s2, 0, true, object->getCurrentlyProcessedMessage().getSender());
-                       }),
-                                   sdbus::registerMethod("UnInhibit").implementedAs([object = obj.get()](uint32_t c) {
-                                       handleDbusScreensaver("", "", c, false, object->getCurrentlyProcessedMessage().getSender());
-                                   }))
-                        .forInterface(sdbus::InterfaceName{"org.freedesktop.ScreenSaver"});
-
-                    m_sDBUSState.screenSaverObjects.push_back(std::move(obj));
-                } catch (std::exception& e) { Debug::log(ERR, "Failed registering for {}, perhaps taken?\nerr: {}", path, e.what()); }
-            }
+    m_sDBUSState.ignoreDbusInhibit = *IGNOREDBUSINHIBIT;
 
-            m_sDBUSState.screenSaverServiceConnection->addMatch("type='signal',sender='org.freedesktop.DBus',interface='org.freedesktop.DBus',member='NameOwnerChanged'",
-                                                                ::handleDbusNameOwnerChanged);
-        } catch (sdbus::Error& e) {
-            if (e.getName() == sdbus::Error::Name{"org.freedesktop.DBus.Error.FileExists"}) {
-                Debug::log(ERR, "Another service is already providing the org.freedesktop.ScreenSaver interface");
-                Debug::log(ERR, "Is hypridle already running?");
-            } else
-                Debug::log(ERR, "Failed to connect to ScreenSaver service\nerr: {}", e.what());
-        }
+    // the metrics are there whether we get to be the ScreenSaver or not
+    try {
+        m_sDBUSState.sessionConnection = sdbus::createSessionBusConnection();
+    } catch (sdbus::Error& e) {
+        Debug::log(ERR, "Failed to connect to the session bus\nerr: {}", e.what());
+        return;
+    }
+
+    try {
+        m_sDBUSState.sessionConnection->requestName(sdbus::ServiceName{"org.hyprland.Hypridle"});
+    } catch (sdbus::Error& e) { Debug::log(WARN, "Couldn't own org.hyprland.Hypridle, the metrics are only on our unique name\nerr: {}", e.what()); }
+
+    setupMetricsObject();
+    watchDbusConnection(m_sDBUSState.sessionConnection.get(), CMetrics::EVENT_SOURCE_SESSION_BUS);
+
+    if (*IGNOREDBUSINHIBIT)
+        return;
+
+    try {
+        m_sDBUSState.sessionConnection->requestName(sdbus::ServiceName{"org.freedesktop.ScreenSaver"});
+    } catch (sdbus::Error& e) {
+        if (e.getName() == sdbus::Error::Name{"org.freedesktop.DBus.Error.FileExists"}) {
+            Debug::log(ERR, "Another service is already providing the org.freedesktop.ScreenSaver interface");
+            Debug::log(ERR, "Is hypridle already running?");
+        } else
+            Debug::log(ERR, "Failed to connect to ScreenSaver service\nerr: {}", e.what());
+        return;
+    }
+
+    // attempt to register as ScreenSaver
+    std::string paths[] = {
+        "/org/freedesktop/ScreenSaver",
+        "/ScreenSaver",
+    };
+
+    for (const std::string& path : paths) {
+        try {
+            auto obj = sdbus::createObject(*m_sDBUSState.sessionConnection, sdbus::ObjectPath{path});
+
+            obj->addVTable(sdbus::registerMethod("Inhibit").implementedAs([object = obj.get()](std::string s1, std::string s2) {
+                   return handleDbusScreensaver(s1, s2, 0, true, object->getCurrentlyProcessedMessage().getSender());
+               }),
+                           sdbus::registerMethod("UnInhibit").implementedAs([object = obj.get()](uint32_t c) {
+                               handleDbusScreensaver("", "", c, false, object->getCurrentlyProcessedMessage().getSender());
+                           }))
+                .forInterface(sdbus::InterfaceName{"org.freedesktop.ScreenSaver"});
+
+            m_sDBUSState.screenSaverObjects.push_back(std::move(obj));
+        } catch (std::exception& e) { Debug::log(ERR, "Failed registering for {}, perhaps taken?\nerr: {}", path, e.what()); }
     }
 
-    systemConnection.reset();
+    try {
+        m_sDBUSState.sessionConnection->addMatch("type='signal',sender='org.freedesktop.DBus',interface='org.freedesktop.DBus',member='NameOwnerChanged'",
+                                                 ::handleDbusNameOwnerChanged);
+    } catch (sdbus::Error& e) { Debug::log(ERR, "Failed to watch for disconnecting inhibitors\nerr: {}", e.what()); }
+}
+
+void CHypridle::setupMetricsObject() {
+    try {
+        m_sDBUSState.metricsObject = sdbus::createObject(*m_sDBUSState.sessionConnection, sdbus::ObjectPath{"/org/hyprland/Hypridle"});
+
+        const auto HISTOGRAM = [](const CLatencyHistogram& h) { return sdbus::Struct<uint64_t, uint64_t, std::vector<uint64_t>>{h.count(), h.sumUs(), h.buckets()}; };
+
+        m_sDBUSState.metricsObject
+            ->addVTable(sdbus::registerProperty("EventsDispatched").withGetter([]() {
+                return std::map<std::string, uint64_t>{
+                    {"wayland", g_pMetrics->eventsDispatched[CMetrics::EVENT_SOURCE_WAYLAND]},
+                    {"system_bus", g_pMetrics->eventsDispatched[CMetrics::EVENT_SOURCE_SYSTEM_BUS]},
+                    {"session_bus", g_pMetrics->eventsDispatched[CMetrics::EVENT_SOURCE_SESSION_BUS]},
+                };
+            }),
+                        // (count, sum in us, buckets), see HistogramBoundsUs
+                        sdbus::registerProperty("DispatchLatency").withGetter([HISTOGRAM]() { return HISTOGRAM(g_pMetrics->dispatchLatency); }),
+                        sdbus::registerProperty("SpawnLatency").withGetter([HISTOGRAM]() { return HISTOGRAM(g_pMetrics->spawnLatency); }),
+                        // idle_to_on_timeout, resume_to_on_resume and sleep_to_inhibitor_release
+                        sdbus::registerProperty("ActionLatency").withGetter([HISTOGRAM]() {
+                            std::map<std::string, sdbus::Struct<uint64_t, uint64_t, std::vector<uint64_t>>> actions;
+                            for (size_t i = 0; i < CMetrics::ACTION_COUNT; ++i) {
+                                actions.emplace(CMetrics::actionName((CMetrics::eAction)i), HISTOGRAM(g_pMetrics->actionLatency[i]));
+                            }
+                            return actions;
+                        }),
+                        sdbus::registerProperty("HistogramBoundsUs").withGetter([]() { return CLatencyHistogram::bucketBoundsUs(); }),
+                        sdbus::registerProperty("Spawns").withGetter([]() { return g_pMetrics->spawns; }),
+                        sdbus::registerProperty("SpawnFailures").withGetter([]() { return g_pMetrics->spawnFailures; }),
+                        // (timeout, idled, resumed) per listener, in config order
+                        sdbus::registerProperty("Listeners").withGetter([this]() {
+                            std::vector<sdbus::Struct<uint64_t, uint64_t, uint64_t>> listeners;
+                            for (const auto& l : m_sWaylandIdleState.listeners) {
+                                listeners.emplace_back(l->rule.timeout, l->idledCount, l->resumedCount);
+                            }
+                            return listeners;
+                        }),
+                        sdbus::registerProperty("InhibitLocks").withGetter([this]() { return m_iInhibitLocks; }),
+                        sdbus::registerProperty("InhibitTotals").withGetter([]() {
+                            return std::map<std::string, uint64_t>{
+                                {"screensaver", g_pMetrics->inhibitTotals[CMetrics::INHIBIT_SOURCE_SCREENSAVER]},
+                                {"systemd", g_pMetrics->inhibitTotals[CMetrics::INHIBIT_SOURCE_SYSTEMD]},
+                            };
+                        }),
+                        sdbus::registerProperty("InhibitsPerApp").withGetter([this]() {
+                            std::map<std::string, uint64_t> apps;
+                            for (const auto& [app, count] : m_sDBUSState.inhibitCookies.countsPerApp()) {
+                                apps[app] = count;
+                            }
+                            return apps;
+                        }),
+                        sdbus::registerProperty("SleepInhibitorHolds").withGetter([]() { return g_pMetrics->sleepInhibitorHolds; }),
+                        sdbus::registerProperty("SleepInhibitorHeldUs").withGetter([]() {
+                            return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(g_pMetrics->sleepInhibitorHeldTotal()).count();
+                        }))
+            .forInterface(sdbus::InterfaceName{"org.hyprland.Hypridle.Metrics"});
+    } catch (std::exception& e) { Debug::log(ERR, "Failed to export metrics on dbus ({})", e.what()); }
 }
 
 void CHypridle::handleInhibitOnDbusSleep(bool toSleep) {
@@ -587,13 +1559,55 @@ void CHypridle::handleInhibitOnDbusSleep(bool toSleep) {
     )
         return;
 
+    // resumed before the session got locked
+    if (m_sDBUSState.sleepLockWaitTimer) {
+        g_pEventLoop->removeTimer(m_sDBUSState.sleepLockWaitTimer);
+        m_sDBUSState.sleepLockWaitTimer = 0;
+        if (!toSleep)
+            uninhibitSleep();
+    }
+
     if (!toSleep)
         inhibitSleep();
     else
         uninhibitSleep();
 }
 
+// logind's default InhibitDelayMaxSec, it goes to sleep after that anyway
+constexpr std::chrono::milliseconds LOCK_WAIT_TIMEOUT = std::chrono::milliseconds{5000};
+
+void CHypridle::releaseSleepOnLock() {
+    if (m_inhibitSleepBehavior != SLEEP_INHIBIT_NORMAL)
+        return;
+
+    // already locked, or a compositor that won't tell us when it is
+    if (m_isLocked || (!m_sWaylandState.lockNotifier && !m_sReplayState.active)) {
+        uninhibitSleep();
+        return;
+    }
+
+    Debug::log(LOG, "Holding the sleep inhibitor until the session is locked");
+
+    m_sDBUSState.sleepLockWaitTimer = g_pEventLoop->addTimer(LOCK_WAIT_TIMEOUT, [this]() {
+        Debug::log(WARN, "The session didn't get locked within {}ms, releasing the sleep inhibitor anyway", LOCK_WAIT_TIMEOUT.count());
+        m_sDBUSState.sleepLockWaitTimer = 0;
+        uninhibitSleep();
+    });
+}
+
+// logind is known to be slow right after resume, but we don't want to wait forever either
+constexpr std::chrono::milliseconds SLEEP_INHIBIT_TIMEOUT = std::chrono::milliseconds{10000};
+
 void CHypridle::inhibitSleep() {
+    if (m_sReplayState.active) {
+        if (!m_sReplayState.sleepInhibited) {
+            replayReport("take sleep inhibitor");
+            g_pMetrics->onSleepInhibitorAcquired();
+        }
+        m_sReplayState.sleepInhibited = true;
+        return;
+    }
+
     if (!m_sDBUSState.login) {
         Debug::log(WARN, "Can't inhibit sleep. Dbus logind interface is not available.");
         return;
@@ -604,15 +1618,63 @@ void CHypridle::inhibitSleep() {
         m_sDBUSState.sleepInhibitFd.reset();
     }
 
+    if (m_sDBUSState.sleepInhibitCall.isPending()) {
+        Debug::log(LOG, "Sleep inhibitor request is already in flight");
+        return;
+    }
+
     auto method = m_sDBUSState.login->createMethodCall(sdbus::InterfaceName{"org.freedesktop.login1.Manager"}, sdbus::MethodName{"Inhibit"});
     method << "sleep";
     method << "hypridle";
     method << "Hypridle wants to delay sleep until it's before_sleep handling is done.";
     method << "delay";
 
+    const auto GENERATION              = ++m_sDBUSState.sleepInhibitGeneration;
+    m_sDBUSState.sleepInhibitRequested = std::chrono::steady_clock::now();
+
     try {
-        auto reply = m_sDBUSState.login->callMethod(method);
+        m_sDBUSState.sleepInhibitCall = m_sDBUSState.login->callMethodAsync(
+            method, [this, GENERATION](sdbus::MethodReply reply, std::optional<sdbus::Error> error) { onSleepInhibitReply(GENERATION, reply, error); });
+    } catch (const std::exception& e) {
+        Debug::log(ERR, "Failed to inhibit sleep ({})", e.what());
+        return;
+    }
+
+    m_sDBUSState.sleepInhibitTimer = g_pEventLoop->addTimer(SLEEP_INHIBIT_TIMEOUT, [this, GENERATION]() {
+        m_sDBUSState.sleepInhibitTimer = 0;
+        notifyReady();
+
+        if (GENERATION != m_sDBUSState.sleepInhibitGeneration || !m_sDBUSState.sleepInhibitCall.isPending())
+            return;
+
+        Debug::log(ERR, "Failed to inhibit sleep, logind did not reply within {}ms", SLEEP_INHIBIT_TIMEOUT.count());
+        m_sDBUSState.sleepInhibitCall.cancel();
+        ++m_sDBUSState.sleepInhibitGeneration;
+    });
+
+    Debug::log(TRACE, "Sleep inhibitor requested (generation {})", GENERATION);
+}
+
+void CHypridle::onSleepInhibitReply(uint64_t generation, sdbus::MethodReply& reply, const std::optional<sdbus::Error>& error) {
+    if (generation != m_sDBUSState.sleepInhibitGeneration) {
+        // superseded by uninhibitSleep, e.g. PrepareForSleep arrived in the meantime. The fd is closed together with the reply.
+        Debug::log(LOG, "Dropping stale sleep inhibitor reply");
+        return;
+    }
 
+    if (m_sDBUSState.sleepInhibitTimer) {
+        g_pEventLoop->removeTimer(m_sDBUSState.sleepInhibitTimer);
+        m_sDBUSState.sleepInhibitTimer = 0;
+    }
+
+    notifyReady();
+
+    if (error) {
+        Debug::log(ERR, "Failed to inhibit sleep ({})", error->what());
+        return;
+    }
+
+    try {
         if (!reply || !reply.isValid()) {
             Debug::log(ERR, "Failed to inhibit sleep");
             return;
@@ -633,16 +1695,259 @@ void CHypridle::inhibitSleep() {
         m_sDBUSState.sleepInhibitFd = immidiateFD.duplicate(F_DUPFD_CLOEXEC);
         immidiateFD.reset(); // close the fd that was opened with dup
 
-        Debug::log(LOG, "Inhibited sleep with fd {}", m_sDBUSState.sleepInhibitFd.get());
+        g_pMetrics->onSleepInhibitorAcquired();
+
+        Debug::log(LOG, "Inhibited sleep with fd {} after {}ms", m_sDBUSState.sleepInhibitFd.get(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_sDBUSState.sleepInhibitRequested).count());
     } catch (const std::exception& e) { Debug::log(ERR, "Failed to inhibit sleep ({})", e.what()); }
 }
 
 void CHypridle::uninhibitSleep() {
+    if (m_sReplayState.active) {
+        if (m_sReplayState.sleepInhibited) {
+            replayReport("release sleep inhibitor");
+            g_pMetrics->onSleepInhibitorReleased();
+        }
+        m_sReplayState.sleepInhibited = false;
+        return;
+    }
+
+    bool cancelled = false;
+
+    if (m_sDBUSState.sleepInhibitCall.isPending()) {
+        cancelled = true;
+        Debug::log(LOG, "Cancelling the in-flight sleep inhibitor request");
+        m_sDBUSState.sleepInhibitCall.cancel();
+        ++m_sDBUSState.sleepInhibitGeneration;
+
+        if (m_sDBUSState.sleepInhibitTimer) {
+            g_pEventLoop->removeTimer(m_sDBUSState.sleepInhibitTimer);
+            m_sDBUSState.sleepInhibitTimer = 0;
+        }
+
+        // READY=1 was held back for this request, don't wait on a reply that won't come anymore
+        notifyReady();
+    }
+
     if (!m_sDBUSState.sleepInhibitFd.isValid()) {
-        Debug::log(ERR, "No sleep inhibitor fd to release");
+        if (!cancelled)
+            Debug::log(ERR, "No sleep inhibitor fd to release");
         return;
     }
 
     Debug::log(LOG, "Releasing the sleep inhibitor!");
     m_sDBUSState.sleepInhibitFd.reset();
+    g_pMetrics->onSleepInhibitorReleased();
+}
+
+bool CHypridle::sleepInhibitActive() {
+    if (m_sReplayState.active)
+        return m_sReplayState.sleepInhibited;
+
+    return m_sDBUSState.sleepInhibitFd.isValid() || m_sDBUSState.sleepInhibitCall.isPending();
+}
+
+sdbus::IProxy* CHypridle::getLoginSession() {
+    return m_sDBUSState.session.get();
+}
+
+// logind answers right away, this only keeps a wedged logind from holding up the action graph
+constexpr std::chrono::milliseconds LOGIND_REPLY_TIMEOUT = std::chrono::milliseconds{2000};
+
+struct SLogindCall {
+    std::optional<sdbus::PendingAsyncCall> call;
+    uint64_t                               timer = 0;
+    std::function<void()>                  done;
+};
+
+// whichever comes first, the reply or the deadline
+static void finishLogindCall(const SP<SLogindCall>& call) {
+    if (call->timer)
+        g_pEventLoop->removeTimer(call->timer);
+    call->timer = 0;
+
+    if (!call->done)
+        return;
+
+    auto done  = std::move(call->done);
+    call->done = nullptr;
+    done();
+}
+
+void CHypridle::runLogindAction(const CConfigManager::SAction& action, std::function<void()> done) {
+    static const std::unordered_map<std::string, std::pair<bool /* session */, const char*>> METHODS = {
+        {"lock-session", {true, "Lock"}},
+        {"unlock-session", {true, "Unlock"}},
+        {"set-idle-hint", {true, "SetIdleHint"}},
+        {"suspend", {false, "Suspend"}},
+        {"hibernate", {false, "Hibernate"}},
+        {"suspend-then-hibernate", {false, "SuspendThenHibernate"}},
+    };
+
+    const auto IT = METHODS.find(action.verb);
+    if (IT == METHODS.end()) {
+        done();
+        return;
+    }
+
+    const auto [SESSION, NAME] = IT->second;
+    const auto PROXY           = SESSION ? m_sDBUSState.session.get() : m_sDBUSState.login.get();
+
+    if (!PROXY) {
+        Debug::log(ERR, "Can't run logind:{}, logind is not available", action.verb);
+        done();
+        return;
+    }
+
+    const auto CALL = makeShared<SLogindCall>(SLogindCall{.done = std::move(done)});
+
+    try {
+        auto method = PROXY->createMethodCall(sdbus::InterfaceName{SESSION ? "org.freedesktop.login1.Session" : "org.freedesktop.login1.Manager"}, sdbus::MethodName{NAME});
+
+        // SetIdleHint's hint, and interactive = false for the sleep methods
+        if (action.verb == "set-idle-hint")
+            method << (action.args[0] == "true");
+        else if (!SESSION)
+            method << false;
+
+        CALL->call = PROXY->callMethodAsync(method, [CALL, NAME](sdbus::MethodReply reply, std::optional<sdbus::Error> error) {
+            if (error)
+                Debug::log(ERR, "logind {} failed: {}", NAME, error->what());
+            finishLogindCall(CALL);
+        });
+
+        CALL->timer = g_pEventLoop->addTimer(LOGIND_REPLY_TIMEOUT, [CALL, NAME]() {
+            Debug::log(ERR, "logind {} didn't reply within {}ms", NAME, LOGIND_REPLY_TIMEOUT.count());
+            CALL->timer = 0;
+            if (CALL->call)
+                CALL->call->cancel();
+            finishLogindCall(CALL);
+        });
+    } catch (const std::exception& e) {
+        Debug::log(ERR, "logind {} failed: {}", NAME, e.what());
+        finishLogindCall(CALL);
+    }
+}
+
+int CHypridle::replay(const std::string& path, double speed) {
+    const auto EVENTS = CEventRecorder::load(path);
+    if (!EVENTS)
+        return 1;
+
+    Debug::log(LOG, "Replaying {} events from {} at {}", EVENTS->size(), path, speed > 0 ? std::format("{}x speed", speed) : std::string{"full speed"});
+
+    m_sReplayState.active = true;
+    m_sReplayState.speed  = speed;
+    m_sReplayState.start  = std::chrono::steady_clock::now();
+
+    g_pExecutor->setDryRun([this](const std::string& command) { replayReport(std::format("spawn {}", command)); });
+
+    static const auto MAXPROCESSES = g_pConfigManager->getValue<Hyprlang::INT>("general:max_processes");
+    g_pExecutor->setMaxProcesses(std::max<Hyprlang::INT>(*MAXPROCESSES, 0));
+
+    updateListeners();
+
+    const bool LOCKNOTIFY = !EVENTS->empty() && EVENTS->front().type == CEventRecorder::EVENT_START && EVENTS->front().value;
+    setupSleepInhibitBehavior(LOCKNOTIFY);
+    if (m_inhibitSleepBehavior != SLEEP_INHIBIT_NONE)
+        inhibitSleep();
+
+    g_pEventLoop->setSignalHandler([](int sig) { g_pEventLoop->terminate(); });
+    g_pEventLoop->addPreWaitHook([this]() { flushActions(); });
+
+    // cookies handed out during the replay don't have to match the recorded ones
+    std::unordered_map<uint64_t, uint32_t> cookies;
+
+    for (const auto& ev : *EVENTS) {
+        const uint64_t TIMEUS = ev.timeUs;
+        const auto     DELAY  = speed > 0 ? std::chrono::milliseconds((uint64_t)(TIMEUS / 1000 / speed)) : std::chrono::milliseconds{0};
+
+        g_pEventLoop->addTimer(DELAY, [this, &ev, &cookies, TIMEUS]() {
+            m_sReplayState.eventTimeUs = TIMEUS;
+            m_sReplayState.inEvent     = true;
+            Debug::log(LOG, "[replay] +{}us {} ({}, {})", TIMEUS, CEventRecorder::typeName(ev.type), ev.value, ev.arg);
+
+            const auto STRING = [&ev](size_t i) { return i < ev.strings.size() ? ev.strings[i] : std::string{}; };
+
+            switch (ev.type) {
+                case CEventRecorder::EVENT_IDLED:
+                case CEventRecorder::EVENT_RESUMED: {
+                    // recordings from before multi-seat have no seat name, those all go to the unnamed seat
+                    auto seat = std::ranges::find_if(m_sWaylandIdleState.seats, [&STRING](const auto& s) { return s->name == STRING(0); });
+                    if (seat == m_sWaylandIdleState.seats.end()) {
+                        auto newSeat  = makeShared<SSeat>();
+                        newSeat->name = STRING(0);
+                        m_sWaylandIdleState.seats.emplace_back(newSeat);
+                        updateListeners();
+                        seat = std::ranges::find(m_sWaylandIdleState.seats, newSeat);
+                    }
+
+                    const auto GROUP = std::ranges::find_if((*seat)->groups, [&ev](const auto& g) { return g->timeout == ev.value && g->ignoreInhibit == !!ev.arg; });
+                    if (GROUP == (*seat)->groups.end()) {
+                        Debug::log(WARN, "[replay] No listener with timeout {} in the current config, skipping", ev.value);
+                        break;
+                    }
+
+                    if (ev.type == CEventRecorder::EVENT_IDLED)
+                        onGroupIdled(GROUP->get());
+                    else
+                        onGroupResumed(GROUP->get());
+                } break;
+                case CEventRecorder::EVENT_LOCKED: onLocked(); break;
+                case CEventRecorder::EVENT_UNLOCKED: onUnlocked(); break;
+                case CEventRecorder::EVENT_SCREENSAVER_INHIBIT: {
+                    cookies[ev.value] = handleDbusScreensaver(STRING(0), STRING(1), 0, true, STRING(2).c_str());
+                } break;
+                case CEventRecorder::EVENT_SCREENSAVER_UNINHIBIT: {
+                    const auto IT = cookies.find(ev.value);
+                    handleDbusScreensaver("", "", IT == cookies.end() ? 0 : IT->second, false, STRING(0).c_str());
+                } break;
+                case CEventRecorder::EVENT_OWNER_LOST: handleOwnerLost(STRING(0)); break;
+                case CEventRecorder::EVENT_BLOCK_INHIBITED: handleDbusBlockInhibits(STRING(0)); break;
+                case CEventRecorder::EVENT_PREPARE_FOR_SLEEP: handlePrepareForSleep(!!ev.value); break;
+                case CEventRecorder::EVENT_SESSION_LOCK: handleSessionLockRequest("Lock"); break;
+                case CEventRecorder::EVENT_SESSION_UNLOCK: handleSessionLockRequest("Unlock"); break;
+                default: break;
+            }
+
+            // every recorded event gets a graph of its own, like a dispatch would
+            flushActions();
+
+            m_sReplayState.inEvent = false;
+        });
+    }
+
+    // let timers started by the last event (deadlines etc.) settle as well
+    const auto END = EVENTS->empty() ? 0 : EVENTS->back().timeUs;
+    g_pEventLoop->addTimer(std::chrono::milliseconds(speed > 0 ? (uint64_t)(END / 1000 / speed) : 0) + std::chrono::milliseconds{100}, []() { g_pEventLoop->terminate(); });
+
+    g_pEventLoop->enter();
+
+    constexpr size_t MAXREPORTED = 1000;
+
+    Debug::log(NONE, "Replay of {} events done, {} actions:", EVENTS->size(), m_sReplayState.report.size());
+    for (size_t i = 0; i < std::min(m_sReplayState.report.size(), MAXREPORTED); ++i) {
+        const auto& [timeUs, action] = m_sReplayState.report[i];
+        Debug::log(NONE, "  +{}.{:06}s {}", timeUs / 1000000, timeUs % 1000000, action);
+    }
+
+    if (m_sReplayState.report.size() > MAXREPORTED)
+        Debug::log(NONE, "  ... and {} more", m_sReplayState.report.size() - MAXREPORTED);
+
+    Debug::log(NONE, "Final state: idled {}, inhibit locks {}, locked {}, sleep inhibitor {}", isIdle(), m_iInhibitLocks, m_isLocked, m_sReplayState.sleepInhibited);
+
+    return 0;
+}
+
+void CHypridle::replayReport(std::string&& action) {
+    // actions are stamped with recording time, so that they line up with the events no matter the replay speed
+    uint64_t timeUs = m_sReplayState.eventTimeUs;
+    if (!m_sReplayState.inEvent && m_sReplayState.speed > 0) {
+        // started by one of our own timers
+        const auto ELAPSED = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_sReplayState.start).count();
+        timeUs             = std::max(timeUs, (uint64_t)(ELAPSED * m_sReplayState.speed));
+    }
+
+    Debug::log(LOG, "[replay] +{}us {}", timeUs, action);
+    m_sReplayState.report.emplace_back(timeUs, std::move(action));
 }
@@ -1,65 +1,163 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 #include <sdbus-c++/sdbus-c++.h>
 #include <hyprutils/os/FileDescriptor.hpp>
-#include <condition_variable>
 
 #include "wayland.hpp"
 #include "ext-idle-notify-v1.hpp"
 #include "hyprland-lock-notify-v1.hpp"
 
 #include "../defines.hpp"
+#include "../config/ConfigManager.hpp"
+#include "Executor.hpp"
+#include "DbusInhibitRegistry.hpp"
+#include "Metrics.hpp"
+#include "ActionGraph.hpp"
 
 class CHypridle {
   public:
-    CHypridle();
+    struct SSeat;
 
     struct SIdleListener {
-        SP<CCExtIdleNotificationV1> notification     = nullptr;
-        std::string                 onTimeout        = "";
-        std::string                 onRestore        = "";
-        bool                        ignoreInhibit    = false;
-        bool                        onTimeoutFired   = false;
+        CConfigManager::STimeoutRule rule;
+        bool                         onTimeoutFired = false;
+        WP<CExecutor::SProcess>      timeoutProcess;
+        uint64_t                     idledCount   = 0;
+        uint64_t                     resumedCount = 0;
+
+        // hysteresis timers for min_idle_ms and resume_grace_ms, 0 when nothing is pending
+        uint64_t pendingTimeout = 0;
+        uint64_t pendingResume  = 0;
+        // input-only notification while on-resume is held, tells a bumped mouse from someone coming back
+        SP<CCExtIdleNotificationV1> settleNotification;
+
+        WP<SSeat> seat;
     };
 
-    struct SDbusInhibitCookie {
-        uint32_t    cookie = 0;
-        std::string app, reason, ownerID;
+    // Listeners sharing a timeout and inhibit mode share one notification object
+    struct SIdleGroup {
+        SP<CCExtIdleNotificationV1>    notification  = nullptr;
+        uint64_t                       timeout       = 0;
+        bool                           ignoreInhibit = false;
+        std::vector<WP<SIdleListener>> listeners; // in config order
+
+        bool                           idled = false;
+        // idled while inhibited, needs a new notification to fire once the inhibitors are gone
+        bool missedIdle = false;
+
+        // with general:derive_idle_tiers, longer tiers have no notification of their own and are timed from the shortest one of their class
+        WP<SIdleGroup> base;
+        uint64_t       derivedTimer = 0;
+
+        WP<SSeat>      seat;
+    };
+
+    // Every wl_seat gets its own listeners, for the rules whose seat key matches its name
+    struct SSeat {
+        uint32_t                       registryName = 0;
+        std::string                    name; // empty until the compositor sent it
+        SP<CCWlSeat>                   seat = nullptr;
+
+        std::vector<SP<SIdleListener>> listeners;
+        std::vector<SP<SIdleGroup>>    groups;
+        bool                           idled = false;
     };
 
     void               run();
+    // --startup-profile, prints the time spent in each startup phase once the daemon is up
+    void               enableStartupProfile(std::chrono::steady_clock::time_point processStart);
+    // Feeds a recording from --record through the handlers, without a compositor or bus. Commands are reported instead of run.
+    // speed scales the recorded timing, 0 replays as fast as possible
+    int                replay(const std::string& path, double speed);
 
     void               onGlobal(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version);
     void               onGlobalRemoved(void* data, struct wl_registry* registry, uint32_t name);
 
     void               onIdled(SIdleListener*);
     void               onResumed(SIdleListener*);
+    void               onGroupIdled(SIdleGroup*);
+    void               onGroupResumed(SIdleGroup*);
+
+    void               onInhibit(bool lock, int64_t count = 1);
+    int64_t            inhibitLocks() const;
+
+    // whether any seat is idle
+    bool               isIdle() const;
+    bool               isLocked() const;
+    const std::vector<SP<SSeat>>&         getSeats() const;
+    // of all seats, seat by seat
+    const std::vector<SP<SIdleListener>>& getListeners() const;
+    // runs on-timeout right away, inhibitors or not. The next resume runs on-resume as usual.
+    bool               fireListener(size_t index);
+    // forgets that on-timeout ran, so that the next resume won't run on-resume
+    bool               resetListener(size_t index);
 
-    void               onInhibit(bool lock);
+    void               reloadConfig();
 
     void               onLocked();
     void               onUnlocked();
 
-    SDbusInhibitCookie getDbusInhibitCookie(uint32_t cookie);
-    void               registerDbusInhibitCookie(SDbusInhibitCookie& cookie);
-    bool               unregisterDbusInhibitCookie(const SDbusInhibitCookie& cookie);
-    size_t             unregisterDbusInhibitCookies(const std::string& ownerID);
+    CDbusInhibitRegistry& getDbusInhibitCookies();
 
     void               handleInhibitOnDbusSleep(bool toSleep);
+    // before_sleep_cmd = logind:lock-session is done, let the system sleep once the session is locked
+    void               releaseSleepOnLock();
     void               inhibitSleep();
     void               uninhibitSleep();
+    bool               sleepInhibitActive();
+    // our logind session, nullptr without logind
+    sdbus::IProxy*     getLoginSession();
+    // logind: actions, async on our system bus connection. done is called once logind replied.
+    void               runLogindAction(const CConfigManager::SAction& action, std::function<void()> done);
 
   private:
     void    setupDBUS();
+    void    setupSleepInhibitBehavior(bool lockNotify);
+    void    setupScreenSaver();
+    void    watchDbusConnection(sdbus::IConnection* connection, CMetrics::eEventSource source);
+    void    startupPhase(const char* name);
+    void    onStartupDone();
+    void    notifyReady();
+    void    watchdogPing();
+    void    setupMetricsObject();
+    void    onSleepInhibitReply(uint64_t generation, sdbus::MethodReply& reply, const std::optional<sdbus::Error>& error);
     void    enterEventLoop();
+    void    dispatchWayland(uint32_t events);
+    bool    connectWayland(const char* name);
+    void    armWayland();
+    void    setupLockNotification();
+    void    dropIdleNotifications();
+    void    onWaylandDisconnected();
+    void    reconnectWayland();
+    void    updateListeners();
+    void    updateSeatListeners(const SP<SSeat>& seat, bool rearmAll);
+    void    addSeat(uint32_t registryName, uint32_t version);
+    void    removeSeat(uint32_t registryName);
+    void    armIdleGroup(SIdleGroup* group);
+    void    startDerivedTimer(SIdleGroup* group, std::chrono::milliseconds delay);
+    void    runOnTimeout(SIdleListener* pListener);
+    void    runOnResume(SIdleListener* pListener);
+    void    cancelPending(SIdleListener* pListener);
+    void    armResumeSettle(SIdleListener* pListener);
+    void    dropResumeSettle(SIdleListener* pListener);
+    void    queueAction(SIdleListener* pListener, const std::string& command, CMetrics::eAction action);
+    void    flushActions();
+    void    onSignal(int sig);
+    void    replayReport(std::string&& action);
 
-    bool    m_bTerminate    = false;
-    bool    isIdled         = false;
     bool    m_isLocked      = false;
     int64_t m_iInhibitLocks = 0;
 
+    // when the idled/resumed currently being handled came in, for the action latency metrics
+    std::chrono::steady_clock::time_point m_eventBegin;
+
+    // listener commands of the current dispatch, started as one graph before the loop blocks again
+    SP<CActionGraph>              m_pendingActions;
+    std::vector<SP<CActionGraph>> m_runningActions;
+
     enum {
         SLEEP_INHIBIT_NONE,
         SLEEP_INHIBIT_NORMAL,
@@ -69,33 +167,68 @@ class CHypridle {
     struct {
         wl_display*                      display          = nullptr;
         SP<CCWlRegistry>                 registry         = nullptr;
-        SP<CCWlSeat>                     seat             = nullptr;
         SP<CCHyprlandLockNotifierV1>     lockNotifier     = nullptr;
         SP<CCHyprlandLockNotificationV1> lockNotification = nullptr;
+        uint32_t                         lockNotifierName = 0;
+
+        // listeners are armed, globals showing up from now on get set up right away
+        bool                      armed = false;
+
+        std::chrono::milliseconds reconnectDelay{0};
+        uint64_t                  reconnectTimer = 0;
+        SP<CCWlCallback>          reconnectSync  = nullptr; // done once the new compositor sent its globals
     } m_sWaylandState;
 
     struct {
-        SP<CCExtIdleNotifierV1>    notifier = nullptr;
+        SP<CCExtIdleNotifierV1>        notifier     = nullptr;
+        uint32_t                       notifierName = 0;
 
-        std::vector<SIdleListener> listeners;
+        std::vector<SP<SSeat>>         seats;
+        std::vector<SP<SIdleListener>> listeners; // those of all seats, for the control socket and the metrics
+        bool                           ignoreWaylandInhibit = false;
     } m_sWaylandIdleState;
 
     struct {
         std::unique_ptr<sdbus::IConnection>          connection;
-        std::unique_ptr<sdbus::IConnection>          screenSaverServiceConnection;
+        std::unique_ptr<sdbus::IConnection>          sessionConnection; // ScreenSaver (unless ignore_dbus_inhibit) and the metrics
         std::unique_ptr<sdbus::IProxy>               login;
+        std::unique_ptr<sdbus::IProxy>               session;
         std::vector<std::unique_ptr<sdbus::IObject>> screenSaverObjects;
-        std::vector<SDbusInhibitCookie>              inhibitCookies;
+        std::unique_ptr<sdbus::IObject>              metricsObject;
+        CDbusInhibitRegistry                         inhibitCookies;
         Hyprutils::OS::CFileDescriptor               sleepInhibitFd;
+
+        // as set up at startup, changing them needs a restart
+        bool ignoreDbusInhibit    = false;
+        bool ignoreSystemdInhibit = false;
+
+        // the Inhibit call is async, replies of superseded requests get dropped
+        sdbus::PendingAsyncCall               sleepInhibitCall;
+        uint64_t                              sleepInhibitGeneration = 0;
+        uint64_t                              sleepInhibitTimer      = 0;
+        std::chrono::steady_clock::time_point sleepInhibitRequested;
+        uint64_t                              sleepLockWaitTimer = 0; // see releaseSleepOnLock
     } m_sDBUSState;
 
     struct {
-        std::condition_variable loopSignal;
-        std::mutex              loopMutex;
-        std::atomic<bool>       shouldProcess = false;
-        std::mutex              loopRequestMutex;
-        std::mutex              eventLock;
-    } m_sEventLoopInternals;
+        bool                                          active         = false;
+        double                                        speed          = 1.0;
+        std::chrono::steady_clock::time_point         start;
+        uint64_t                                      eventTimeUs    = 0;
+        bool                                          inEvent        = false;
+        bool                                          sleepInhibited = false;
+        std::vector<std::pair<uint64_t, std::string>> report; // recording time (us), action
+    } m_sReplayState;
+
+    struct {
+        bool                                                                      profile   = false;
+        bool                                                                      done      = false;
+        bool                                                                      readySent = false;
+        std::chrono::microseconds                                                 watchdogInterval{0};
+        std::chrono::steady_clock::time_point                                     start;
+        std::chrono::steady_clock::time_point                                     lastPhase;
+        std::vector<std::pair<const char*, std::chrono::steady_clock::duration>> phases;
+    } m_sStartupState;
 };
 
 inline std::unique_ptr<CHypridle> g_pHypridle;
@@ -0,0 +1,195 @@
+#include "HyprlandIPC.hpp"
+#include "EventLoop.hpp"
+#include "../helpers/Log.hpp"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+// Hyprland answers right away, this only keeps a wedged compositor from holding up the action graph
+constexpr std::chrono::milliseconds REPLY_TIMEOUT = std::chrono::milliseconds{2000};
+
+void CHyprlandIPC::run(const CConfigManager::SAction& action, std::function<void()> done) {
+    std::string request = action.verb;
+    for (const auto& arg : action.args) {
+        request += ' ' + arg;
+    }
+
+    m_queued.emplace_back(SRequest{.request = std::move(request), .done = std::move(done)});
+
+    // from the loop, so that everything else triggered by the same event makes it into the batch
+    if (!m_flushTimer)
+        m_flushTimer = g_pEventLoop->addTimer(std::chrono::milliseconds{0}, [this]() {
+            m_flushTimer = 0;
+            flush();
+        });
+}
+
+std::string CHyprlandIPC::socketPath() {
+    static const auto SOCKET = g_pConfigManager->getValue<Hyprlang::STRING>("general:hyprland_socket");
+
+    if (!std::string{*SOCKET}.empty())
+        return *SOCKET;
+
+    const char* ENVRUNTIME   = getenv("XDG_RUNTIME_DIR");
+    const char* ENVSIGNATURE = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+    if (!ENVRUNTIME || !ENVSIGNATURE || !*ENVSIGNATURE)
+        return "";
+
+    return std::string{ENVRUNTIME} + "/hypr/" + ENVSIGNATURE + "/.socket.sock";
+}
+
+void CHyprlandIPC::followInstance() {
+    const char* ENVRUNTIME   = getenv("XDG_RUNTIME_DIR");
+    const char* ENVSIGNATURE = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+    const char* ENVDISPLAY   = getenv("WAYLAND_DISPLAY");
+
+    // not started from Hyprland
+    if (!ENVRUNTIME || !ENVSIGNATURE || !*ENVSIGNATURE)
+        return;
+
+    const std::string DISPLAY = std::filesystem::path(ENVDISPLAY && *ENVDISPLAY ? ENVDISPLAY : "wayland-0").filename().string();
+
+    // every instance keeps its pid and wayland socket in hypr/<signature>/hyprland.lock
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator{std::string{ENVRUNTIME} + "/hypr", ec}) {
+        std::ifstream lock{entry.path() / "hyprland.lock"};
+        pid_t         pid = 0;
+        std::string   display;
+
+        if (!(lock >> pid >> display) || display != DISPLAY)
+            continue;
+
+        // a crashed instance leaves its directory behind
+        if (pid <= 0 || (kill(pid, 0) < 0 && errno == ESRCH))
+            continue;
+
+        const std::string SIGNATURE = entry.path().filename().string();
+        if (SIGNATURE != ENVSIGNATURE) {
+            Debug::log(LOG, "Hyprland instance on {} is now {}", DISPLAY, SIGNATURE);
+            setenv("HYPRLAND_INSTANCE_SIGNATURE", SIGNATURE.c_str(), 1);
+        }
+
+        return;
+    }
+
+    Debug::log(WARN, "No running Hyprland instance on {}, hyprctl: actions keep going to {}", DISPLAY, ENVSIGNATURE);
+}
+
+void CHyprlandIPC::flush() {
+    auto batch      = makeShared<SBatch>();
+    batch->requests = std::move(m_queued);
+    m_queued.clear();
+
+    if (batch->requests.empty())
+        return;
+
+    std::string message;
+    if (batch->requests.size() == 1)
+        message = batch->requests.front().request;
+    else {
+        message = "[[BATCH]]";
+        for (const auto& r : batch->requests) {
+            message += r.request + ';';
+        }
+    }
+
+    const auto  PATH = socketPath();
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    const auto FAIL = [&batch, &message](const std::string& why) {
+        Debug::log(ERR, "Couldn't send \"{}\" to Hyprland: {}", message, why);
+        for (auto& r : batch->requests) {
+            r.done();
+        }
+    };
+
+    if (PATH.empty())
+        return FAIL("HYPRLAND_INSTANCE_SIGNATURE is not set, is this Hyprland?");
+
+    if (PATH.size() >= sizeof(addr.sun_path))
+        return FAIL(std::format("socket path {} is too long", PATH));
+
+    strncpy(addr.sun_path, PATH.c_str(), sizeof(addr.sun_path) - 1);
+
+    batch->fd = Hyprutils::OS::CFileDescriptor{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)};
+    if (!batch->fd.isValid() || connect(batch->fd.get(), (sockaddr*)&addr, sizeof(addr)) < 0)
+        return FAIL(std::format("connecting to {} failed: {}", PATH, strerror(errno)));
+
+    // a few hundred bytes at most, that always fits into the socket buffer
+    if (send(batch->fd.get(), message.data(), message.size(), MSG_NOSIGNAL) != (ssize_t)message.size())
+        return FAIL(std::format("write failed: {}", strerror(errno)));
+
+    Debug::log(LOG, "Sent \"{}\" to Hyprland", message);
+
+    const int FD = batch->fd.get();
+    batch->timer = g_pEventLoop->addTimer(REPLY_TIMEOUT, [this, FD]() {
+        Debug::log(ERR, "Hyprland didn't reply within {}ms", REPLY_TIMEOUT.count());
+        m_batches[FD]->timer = 0;
+        finish(FD);
+    });
+
+    m_batches[FD] = batch;
+    g_pEventLoop->addFd(FD, EPOLLIN, [this, FD](uint32_t) { onReply(FD); });
+}
+
+void CHyprlandIPC::onReply(int fd) {
+    const auto IT = m_batches.find(fd);
+    if (IT == m_batches.end())
+        return;
+
+    char    buf[1024];
+    ssize_t len = 0;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        IT->second->reply.append(buf, len);
+    }
+
+    // Hyprland hangs up once it replied
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+    finish(fd);
+}
+
+void CHyprlandIPC::finish(int fd) {
+    const auto IT = m_batches.find(fd);
+    if (IT == m_batches.end())
+        return;
+
+    const auto BATCH = IT->second;
+    m_batches.erase(IT);
+
+    g_pEventLoop->removeFd(fd);
+    if (BATCH->timer)
+        g_pEventLoop->removeTimer(BATCH->timer);
+
+    // "ok" per request, separated by empty lines in a batch
+    std::string_view reply = BATCH->reply;
+    while (!reply.empty() && (reply.back() == '\n' || reply.back() == ' '))
+        reply.remove_suffix(1);
+
+    bool ok = !reply.empty();
+    for (size_t pos = 0; ok && pos < reply.size();) {
+        const auto START = reply.find_first_not_of('\n', pos);
+        if (START == std::string_view::npos)
+            break;
+
+        const auto END = reply.find('\n', START);
+        ok             = reply.substr(START, END - START) == "ok";
+        pos            = END == std::string_view::npos ? reply.size() : END;
+    }
+
+    Debug::log(ok ? TRACE : ERR, "Hyprland replied \"{}\"", BATCH->reply);
+
+    for (auto& r : BATCH->requests) {
+        r.done();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+#include "../defines.hpp"
+#include "../config/ConfigManager.hpp"
+
+// hyprctl: actions, written to Hyprland's request socket from the event loop instead of spawning hyprctl.
+// Requests made during one loop iteration go out as a single [[BATCH]]. Hyprland answers and hangs up after every message,
+// so each batch gets a fresh connection. general:hyprland_socket overrides the socket path.
+class CHyprlandIPC {
+  public:
+    // done is called once Hyprland replied, or the request failed
+    void run(const CConfigManager::SAction& action, std::function<void()> done);
+
+    // a restarted Hyprland on our wayland display has a new instance signature. Finds it and exports it to us and our commands.
+    void followInstance();
+
+  private:
+    struct SRequest {
+        std::string           request;
+        std::function<void()> done;
+    };
+
+    struct SBatch {
+        Hyprutils::OS::CFileDescriptor fd;
+        std::string                    reply;
+        std::vector<SRequest>          requests;
+        uint64_t                       timer = 0;
+    };
+
+    std::string                         socketPath();
+    void                                flush();
+    void                                onReply(int fd);
+    void                                finish(int fd);
+
+    std::vector<SRequest>               m_queued;
+    uint64_t                            m_flushTimer = 0;
+    std::unordered_map<int, SP<SBatch>> m_batches;
+};
+
+inline std::unique_ptr<CHyprlandIPC> g_pHyprlandIPC;
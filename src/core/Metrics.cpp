@@ -0,0 +1,101 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <bit>
+
+void CLatencyHistogram::record(std::chrono::steady_clock::duration duration) {
+    const uint64_t US     = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0);
+    const size_t   BUCKET = std::min<size_t>(std::bit_width(US), BUCKETS - 1);
+
+    m_buckets[BUCKET]++;
+    m_count++;
+    m_sumUs += US;
+}
+
+std::vector<uint64_t> CLatencyHistogram::buckets() const {
+    return {m_buckets.begin(), m_buckets.end()};
+}
+
+std::vector<uint64_t> CLatencyHistogram::bucketBoundsUs() {
+    std::vector<uint64_t> bounds;
+    bounds.reserve(BUCKETS);
+
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        bounds.push_back(1ULL << i);
+    }
+
+    return bounds;
+}
+
+uint64_t CLatencyHistogram::count() const {
+    return m_count;
+}
+
+uint64_t CLatencyHistogram::sumUs() const {
+    return m_sumUs;
+}
+
+void CMetrics::onDispatch(eEventSource source, std::chrono::steady_clock::duration duration) {
+    eventsDispatched[source]++;
+    dispatchLatency.record(duration);
+}
+
+void CMetrics::onSpawn(bool success, std::chrono::steady_clock::duration duration) {
+    if (!success) {
+        spawnFailures++;
+        return;
+    }
+
+    spawns++;
+    spawnLatency.record(duration);
+}
+
+void CMetrics::onInhibit(eInhibitSource source) {
+    inhibitTotals[source]++;
+}
+
+void CMetrics::onAction(eAction action, std::chrono::steady_clock::duration duration) {
+    actionLatency[action].record(duration);
+}
+
+const char* CMetrics::actionName(eAction action) {
+    switch (action) {
+        case ACTION_IDLE_TO_TIMEOUT_CMD: return "idle_to_on_timeout";
+        case ACTION_RESUME_TO_RESUME_CMD: return "resume_to_on_resume";
+        case ACTION_SLEEP_TO_RELEASE: return "sleep_to_inhibitor_release";
+        default: return "unknown";
+    }
+}
+
+void CMetrics::onSleepInhibitorAcquired() {
+    if (sleepInhibitorActive)
+        return;
+
+    sleepInhibitorActive = true;
+    sleepInhibitorSince  = std::chrono::steady_clock::now();
+    sleepInhibitorHolds++;
+}
+
+void CMetrics::onSleepInhibitorReleased() {
+    if (!sleepInhibitorActive)
+        return;
+
+    sleepInhibitorActive = false;
+    sleepInhibitorHeld += std::chrono::steady_clock::now() - sleepInhibitorSince;
+
+    if (sleepRequested) {
+        onAction(ACTION_SLEEP_TO_RELEASE, std::chrono::steady_clock::now() - sleepRequestedAt);
+        sleepRequested = false;
+    }
+}
+
+void CMetrics::onPrepareForSleep(bool toSleep) {
+    sleepRequested   = toSleep;
+    sleepRequestedAt = std::chrono::steady_clock::now();
+}
+
+std::chrono::steady_clock::duration CMetrics::sleepInhibitorHeldTotal() const {
+    if (!sleepInhibitorActive)
+        return sleepInhibitorHeld;
+
+    return sleepInhibitorHeld + (std::chrono::steady_clock::now() - sleepInhibitorSince);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// power-of-two microsecond buckets, bucket i counts samples below 2^i us. The last bucket takes everything above.
+class CLatencyHistogram {
+  public:
+    static constexpr size_t BUCKETS = 24; // up to ~8s
+
+    void                         record(std::chrono::steady_clock::duration duration);
+
+    std::vector<uint64_t>        buckets() const;
+    static std::vector<uint64_t> bucketBoundsUs();
+    uint64_t                     count() const;
+    uint64_t                     sumUs() const;
+
+  private:
+    std::array<uint64_t, BUCKETS> m_buckets = {};
+    uint64_t                      m_count   = 0;
+    uint64_t                      m_sumUs   = 0;
+};
+
+class CMetrics {
+  public:
+    enum eEventSource : uint8_t {
+        EVENT_SOURCE_WAYLAND = 0,
+        EVENT_SOURCE_SYSTEM_BUS,
+        EVENT_SOURCE_SESSION_BUS,
+        EVENT_SOURCE_COUNT,
+    };
+
+    enum eInhibitSource : uint8_t {
+        INHIBIT_SOURCE_SCREENSAVER = 0,
+        INHIBIT_SOURCE_SYSTEMD,
+        INHIBIT_SOURCE_COUNT,
+    };
+
+    // from receiving an event to having acted on it
+    enum eAction : uint8_t {
+        ACTION_IDLE_TO_TIMEOUT_CMD = 0, // idled -> on-timeout spawned
+        ACTION_RESUME_TO_RESUME_CMD,    // resumed -> on-resume spawned
+        ACTION_SLEEP_TO_RELEASE,        // PrepareForSleep -> sleep inhibitor released
+        ACTION_COUNT,
+    };
+
+    static const char*                          actionName(eAction action);
+
+    void                                        onDispatch(eEventSource source, std::chrono::steady_clock::duration duration);
+    void                                        onSpawn(bool success, std::chrono::steady_clock::duration duration);
+    void                                        onInhibit(eInhibitSource source);
+    void                                        onAction(eAction action, std::chrono::steady_clock::duration duration);
+    void                                        onSleepInhibitorAcquired();
+    void                                        onSleepInhibitorReleased();
+    void                                        onPrepareForSleep(bool toSleep);
+
+    // includes the currently running hold
+    std::chrono::steady_clock::duration         sleepInhibitorHeldTotal() const;
+
+    std::array<uint64_t, EVENT_SOURCE_COUNT>    eventsDispatched = {};
+    CLatencyHistogram                           dispatchLatency;
+
+    uint64_t                                    spawns        = 0;
+    uint64_t                                    spawnFailures = 0;
+    CLatencyHistogram                           spawnLatency;
+
+    std::array<uint64_t, INHIBIT_SOURCE_COUNT>  inhibitTotals = {};
+
+    std::array<CLatencyHistogram, ACTION_COUNT> actionLatency;
+
+    uint64_t                                    sleepInhibitorHolds  = 0;
+    std::chrono::steady_clock::duration         sleepInhibitorHeld   = {};
+    std::chrono::steady_clock::time_point       sleepInhibitorSince  = {};
+    bool                                        sleepInhibitorActive = false;
+    std::chrono::steady_clock::time_point       sleepRequestedAt     = {};
+    bool                                        sleepRequested       = false;
+};
+
+inline std::unique_ptr<CMetrics> g_pMetrics;
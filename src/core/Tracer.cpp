@@ -0,0 +1,153 @@
+#include "Tracer.hpp"
+#include "../helpers/Log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <unistd.h>
+
+static void copyDetail(std::array<char, 96>& dest, uint8_t& len, std::string_view detail) {
+    len = (uint8_t)std::min(detail.size(), dest.size());
+
+    // don't cut a UTF-8 sequence in half, that makes the whole trace invalid JSON for strict parsers
+    if (len < detail.size()) {
+        while (len > 0 && ((unsigned char)detail[len] & 0xC0) == 0x80) {
+            --len;
+        }
+    }
+
+    std::memcpy(dest.data(), detail.data(), len);
+}
+
+static void appendEscaped(std::string& out, std::string_view str) {
+    for (const char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                    out += std::format("\\u{:04x}", (int)c);
+                else
+                    out += c;
+        }
+    }
+}
+
+CTracer::CTracer(const std::string& path, size_t capacity) : m_path(path), m_start(std::chrono::steady_clock::now()) {
+    // allocated (and touched) once, recording never allocates
+    m_events.resize(std::max<size_t>(capacity, 1));
+}
+
+CTracer::SEvent& CTracer::next() {
+    return m_events[m_head++ % m_events.size()];
+}
+
+uint64_t CTracer::toUs(std::chrono::steady_clock::time_point point) const {
+    return std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(point - m_start).count(), 0);
+}
+
+void CTracer::complete(const char* name, const char* category, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end,
+                       std::string_view detail) {
+    auto& ev    = next();
+    ev.name     = name;
+    ev.category = category;
+    ev.phase    = 'X';
+    ev.tsUs     = toUs(begin);
+    ev.durUs    = toUs(end) - ev.tsUs;
+    ev.id       = 0;
+    copyDetail(ev.detail, ev.detailLen, detail);
+}
+
+void CTracer::instant(const char* name, const char* category, std::string_view detail) {
+    auto& ev    = next();
+    ev.name     = name;
+    ev.category = category;
+    ev.phase    = 'i';
+    ev.tsUs     = toUs(std::chrono::steady_clock::now());
+    ev.durUs    = 0;
+    ev.id       = 0;
+    copyDetail(ev.detail, ev.detailLen, detail);
+}
+
+void CTracer::asyncBegin(const char* name, const char* category, uint64_t id, std::string_view detail) {
+    auto& ev    = next();
+    ev.name     = name;
+    ev.category = category;
+    ev.phase    = 'b';
+    ev.tsUs     = toUs(std::chrono::steady_clock::now());
+    ev.durUs    = 0;
+    ev.id       = id;
+    copyDetail(ev.detail, ev.detailLen, detail);
+}
+
+void CTracer::asyncEnd(const char* name, const char* category, uint64_t id, std::string_view detail) {
+    auto& ev    = next();
+    ev.name     = name;
+    ev.category = category;
+    ev.phase    = 'e';
+    ev.tsUs     = toUs(std::chrono::steady_clock::now());
+    ev.durUs    = 0;
+    ev.id       = id;
+    copyDetail(ev.detail, ev.detailLen, detail);
+}
+
+bool CTracer::write() const {
+    const auto  PID   = getpid();
+    const auto  COUNT = std::min(m_head, m_events.size());
+
+    std::string out;
+    out.reserve(COUNT * 160);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += std::format(R"({{"name":"process_name","ph":"M","pid":{},"tid":{},"args":{{"name":"hypridle"}}}})", PID, PID);
+
+    for (size_t i = m_head - COUNT; i < m_head; ++i) {
+        const auto& ev = m_events[i % m_events.size()];
+
+        out += std::format(",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"{}\",\"ts\":{},\"pid\":{},\"tid\":{}", ev.name, ev.category, ev.phase, ev.tsUs, PID, PID);
+
+        if (ev.phase == 'X')
+            out += std::format(",\"dur\":{}", ev.durUs);
+        else if (ev.phase == 'i')
+            out += ",\"s\":\"t\"";
+        else
+            out += std::format(",\"id\":\"{:#x}\"", ev.id);
+
+        if (ev.detailLen > 0) {
+            out += ",\"args\":{\"detail\":\"";
+            appendEscaped(out, std::string_view{ev.detail.data(), ev.detailLen});
+            out += "\"}";
+        }
+
+        out += '}';
+    }
+
+    out += "\n]}\n";
+
+    std::ofstream ofs(m_path, std::ios::trunc);
+    if (!ofs.good()) {
+        Debug::log(ERR, "Couldn't open {} to write the trace", m_path);
+        return false;
+    }
+
+    ofs << out;
+    ofs.close();
+
+    if (m_head > m_events.size())
+        Debug::log(LOG, "Wrote the last {} trace events to {} ({} older ones were overwritten)", COUNT, m_path, m_head - COUNT);
+    else
+        Debug::log(LOG, "Wrote {} trace events to {}", COUNT, m_path);
+
+    return true;
+}
+
+CTraceSpan::CTraceSpan(const char* name, const char* category, std::string_view detail) : m_name(name), m_category(category), m_detail(detail) {
+    if (g_pTracer)
+        m_begin = std::chrono::steady_clock::now();
+}
+
+CTraceSpan::~CTraceSpan() {
+    if (g_pTracer)
+        g_pTracer->complete(m_name, m_category, m_begin, std::chrono::steady_clock::now(), m_detail);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Records spans into a preallocated ring buffer and writes them out as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+// Names and categories have to be string literals, only the detail is copied.
+class CTracer {
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 65536;
+
+    CTracer(const std::string& path, size_t capacity = DEFAULT_CAPACITY);
+
+    void complete(const char* name, const char* category, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end, std::string_view detail = {});
+    void instant(const char* name, const char* category, std::string_view detail = {});
+
+    // for things outliving a single dispatch, like spawned processes. Begin and end are matched by id.
+    void asyncBegin(const char* name, const char* category, uint64_t id, std::string_view detail = {});
+    void asyncEnd(const char* name, const char* category, uint64_t id, std::string_view detail = {});
+
+    // writes everything currently in the buffer, oldest first
+    bool write() const;
+
+  private:
+    struct SEvent {
+        const char*          name      = nullptr;
+        const char*          category  = nullptr;
+        char                 phase     = 'X';
+        uint64_t             tsUs      = 0;
+        uint64_t             durUs     = 0;
+        uint64_t             id        = 0;
+        std::array<char, 96> detail    = {};
+        uint8_t              detailLen = 0;
+    };
+
+    SEvent&                               next();
+    uint64_t                              toUs(std::chrono::steady_clock::time_point point) const;
+
+    std::string                           m_path;
+    std::vector<SEvent>                   m_events;
+    size_t                                m_head = 0; // total recorded, the buffer wraps around
+    std::chrono::steady_clock::time_point m_start;
+};
+
+inline std::unique_ptr<CTracer> g_pTracer;
+
+// Records a complete span for its scope, does nothing unless --trace was given
+class CTraceSpan {
+  public:
+    CTraceSpan(const char* name, const char* category, std::string_view detail = {});
+    ~CTraceSpan();
+
+    CTraceSpan(const CTraceSpan&)            = delete;
+    CTraceSpan& operator=(const CTraceSpan&) = delete;
+
+  private:
+    const char*                           m_name;
+    const char*                           m_category;
+    std::string_view                      m_detail;
+    std::chrono::steady_clock::time_point m_begin;
+};
+
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+#define TRACE_SPAN_CONCAT(a, b)  TRACE_SPAN_CONCAT_(a, b)
+#define TRACE_SPAN(...)          CTraceSpan TRACE_SPAN_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,195 @@
+#include "Log.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <vector>
+
+constexpr size_t FLIGHT_RECORDER_ENTRIES = 256;
+constexpr size_t FLIGHT_RECORDER_LINE    = 240;
+// past this much unflushed output we write right away instead of waiting for the loop
+constexpr size_t MAX_PENDING_BYTES = 64 * 1024;
+
+struct SFlightRecorderEntry {
+    std::array<char, FLIGHT_RECORDER_LINE> text = {};
+    size_t                                 len  = 0;
+};
+
+// fixed size so that dumping from a signal handler doesn't need to allocate
+static std::array<SFlightRecorderEntry, FLIGHT_RECORDER_ENTRIES> flightRecorder;
+static std::atomic<size_t>                                       flightRecorderHead = 0;
+static std::atomic<bool>                                         flightRecorderDumped = false;
+static std::atomic<void (*)()>                                   crashHook            = nullptr;
+
+static std::string                                               pendingOutput;
+static std::vector<std::string>                                  pendingJournal;
+static int                                                       journalFd = -1;
+
+static const auto                                                START = std::chrono::steady_clock::now();
+
+static const char*                                               levelName(eLogLevel level) {
+    switch (level) {
+        case TRACE: return "TRACE";
+        case INFO: return "INFO";
+        case LOG: return "LOG";
+        case WARN: return "WARN";
+        case ERR: return "ERR";
+        case CRIT: return "CRITICAL";
+        default: return "";
+    }
+}
+
+static int journalPriority(eLogLevel level) {
+    switch (level) {
+        case TRACE: return 7;
+        case WARN: return 4;
+        case ERR: return 3;
+        case CRIT: return 2;
+        default: return 6;
+    }
+}
+
+static void record(eLogLevel level, const std::string& line) {
+    const auto MS    = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - START).count();
+    auto&      entry = flightRecorder[flightRecorderHead.load(std::memory_order_relaxed) % FLIGHT_RECORDER_ENTRIES];
+
+    const auto RESULT = std::format_to_n(entry.text.data(), entry.text.size() - 1, "[{}.{:03}] [{}] {}", MS / 1000, MS % 1000, levelName(level), line);
+    entry.len         = std::min<size_t>(RESULT.size, entry.text.size() - 1);
+    entry.text[entry.len++] = '\n';
+
+    flightRecorderHead.fetch_add(1, std::memory_order_release);
+}
+
+static void writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t RET = write(fd, data, len);
+        if (RET < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        data += RET;
+        len -= RET;
+    }
+}
+
+static std::string journalMessage(eLogLevel level, const std::string& line) {
+    // MESSAGE may contain newlines, so it uses the binary field format: name, newline, 64bit LE size, data, newline
+    std::string msg = std::format("PRIORITY={}\nSYSLOG_IDENTIFIER=hypridle\nMESSAGE\n", journalPriority(level));
+
+    uint64_t    len = line.size();
+    for (int i = 0; i < 8; ++i) {
+        msg += (char)((len >> (i * 8)) & 0xFF);
+    }
+
+    msg += line;
+    msg += '\n';
+    return msg;
+}
+
+void Debug::pushLine(eLogLevel level, std::string&& line) {
+    if (flightRecorder)
+        record(level, line);
+
+    if (!printed(level))
+        return;
+
+    if (journalFd >= 0)
+        pendingJournal.emplace_back(journalMessage(level, line));
+    else {
+        if (level != NONE)
+            pendingOutput += std::format("[{}] ", levelName(level));
+
+        pendingOutput += line;
+        pendingOutput += '\n';
+    }
+
+    if (level >= ERR || pendingOutput.size() > MAX_PENDING_BYTES || pendingJournal.size() > FLIGHT_RECORDER_ENTRIES)
+        flush();
+}
+
+void Debug::flush() {
+    if (!pendingOutput.empty()) {
+        writeAll(STDOUT_FILENO, pendingOutput.data(), pendingOutput.size());
+        pendingOutput.clear();
+    }
+
+    for (const auto& msg : pendingJournal) {
+        if (send(journalFd, msg.data(), msg.size(), MSG_NOSIGNAL) < 0) {
+            // journald went away, fall back to stdout for the rest
+            close(journalFd);
+            journalFd = -1;
+            break;
+        }
+    }
+
+    pendingJournal.clear();
+}
+
+bool Debug::enableJournal() {
+    const int FD = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (FD < 0)
+        return false;
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, "/run/systemd/journal/socket", sizeof(addr.sun_path) - 1);
+
+    if (connect(FD, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(FD);
+        return false;
+    }
+
+    flush();
+    journalFd = FD;
+    return true;
+}
+
+void Debug::dumpFlightRecorder() {
+    if (flightRecorderDumped.exchange(true))
+        return;
+
+    static constexpr char HEADER[] = "\n=== hypridle flight recorder (most recent last) ===\n";
+    static constexpr char FOOTER[] = "=== end of flight recorder ===\n";
+
+    writeAll(STDERR_FILENO, HEADER, sizeof(HEADER) - 1);
+
+    const size_t HEAD  = flightRecorderHead.load(std::memory_order_acquire);
+    const size_t COUNT = std::min(HEAD, FLIGHT_RECORDER_ENTRIES);
+
+    for (size_t i = HEAD - COUNT; i < HEAD; ++i) {
+        const auto& entry = flightRecorder[i % FLIGHT_RECORDER_ENTRIES];
+        writeAll(STDERR_FILENO, entry.text.data(), entry.len);
+    }
+
+    writeAll(STDERR_FILENO, FOOTER, sizeof(FOOTER) - 1);
+}
+
+void Debug::setCrashHook(void (*hook)()) {
+    crashHook = hook;
+}
+
+static void onCrash(int sig) {
+    Debug::dumpFlightRecorder();
+
+    if (const auto HOOK = crashHook.load())
+        HOOK();
+
+    // SA_RESETHAND restored the default action, let it do its thing (coredump)
+    raise(sig);
+}
+
+void Debug::installCrashHandler() {
+    struct sigaction sa = {};
+    sa.sa_handler       = ::onCrash;
+    sa.sa_flags         = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+
+    for (const int SIG : {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL}) {
+        sigaction(SIG, &sa, nullptr);
+    }
+}
@@ -1,6 +1,6 @@
 #pragma once
+#include <cstdio>
 #include <format>
-#include <iostream>
 #include <string>
 
 enum eLogLevel {
@@ -18,6 +18,7 @@ enum eLogLevel {
         Debug::log(CRIT, "\n==========================================================================================\nASSERTION FAILED! \n\n{}\n\nat: line {} in {}",            \
                    std::format(reason, ##__VA_ARGS__), __LINE__,                                                                                                                   \
                    ([]() constexpr -> std::string { return std::string(__FILE__).substr(std::string(__FILE__).find_last_of('/') + 1); })().c_str());                               \
+        Debug::dumpFlightRecorder();                                                                                                                                               \
         printf("Assertion failed! See the log in /tmp/hypr/hyprland.log for more info.");                                                                                          \
         *((int*)nullptr) = 1; /* so that we crash and get a coredump */                                                                                                            \
     }
@@ -25,34 +26,35 @@ enum eLogLevel {
 #define ASSERT(expr) RASSERT(expr, "?")
 
 namespace Debug {
-    inline bool quiet   = false;
-    inline bool verbose = false;
+    inline bool quiet          = false;
+    inline bool verbose        = false;
+    inline bool flightRecorder = true;
 
-    template <typename... Args>
-    void log(eLogLevel level, const std::string& fmt, Args&&... args) {
-
-        if (!verbose && level == TRACE)
-            return;
+    inline bool printed(eLogLevel level) {
+        return !quiet && (verbose || level != TRACE);
+    }
 
-        if (quiet)
-            return;
+    // Lines are buffered and written out when the event loop goes idle, or right away for errors.
+    // The last few lines of every level (even TRACE and quiet ones) are kept in a flight recorder that gets dumped on crashes,
+    // unless --no-flight-recorder turned it off.
+    void pushLine(eLogLevel level, std::string&& line);
+    void flush();
 
-        if (level != NONE) {
-            std::cout << '[';
+    // send lines to journald natively (with priorities) instead of stdout
+    bool enableJournal();
 
-            switch (level) {
-                case TRACE: std::cout << "TRACE"; break;
-                case INFO: std::cout << "INFO"; break;
-                case LOG: std::cout << "LOG"; break;
-                case WARN: std::cout << "WARN"; break;
-                case ERR: std::cout << "ERR"; break;
-                case CRIT: std::cout << "CRITICAL"; break;
-                default: break;
-            }
+    // dumps the flight recorder to stderr on SIGSEGV, SIGABRT, SIGBUS, SIGFPE and SIGILL
+    void installCrashHandler();
+    void dumpFlightRecorder();
+    // runs from the crash handler after the dump, so it has to be async-signal-safe
+    void setCrashHook(void (*hook)());
 
-            std::cout << "] ";
-        }
+    template <typename... Args>
+    void log(eLogLevel level, std::format_string<Args...> fmt, Args&&... args) {
+        // TRACE lines are everywhere, don't format what nobody will see
+        if (!printed(level) && !flightRecorder)
+            return;
 
-        std::cout << std::vformat(fmt, std::make_format_args(args...)) << std::endl;
+        pushLine(level, std::format(fmt, std::forward<Args>(args)...));
     }
-};
\ No newline at end of file
+};
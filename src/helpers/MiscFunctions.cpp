@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 
 #include "MiscFunctions.hpp"
@@ -16,4 +17,21 @@ std::string absolutePath(const std::string& rawpath, const std::string& currentD
         return std::filesystem::weakly_canonical(std::filesystem::path(currentDir) / path);
     else
         return std::filesystem::weakly_canonical(path);
-}
\ No newline at end of file
+}
+
+std::string controlSocketPath() {
+    if (const char* ENVSOCKET = getenv("HYPRIDLE_SOCKET"); ENVSOCKET && *ENVSOCKET)
+        return ENVSOCKET;
+
+    const char* ENVRUNTIME = getenv("XDG_RUNTIME_DIR");
+    const char* ENVDISPLAY = getenv("WAYLAND_DISPLAY");
+
+    // a shared directory like /tmp would let other users race us for the path
+    if (!ENVRUNTIME || !*ENVRUNTIME)
+        return "";
+
+    // WAYLAND_DISPLAY may also be an absolute path
+    const std::string DISPLAY = std::filesystem::path(ENVDISPLAY && *ENVDISPLAY ? ENVDISPLAY : "wayland-0").filename().string();
+
+    return std::string{ENVRUNTIME} + "/hypridle-" + DISPLAY + ".sock";
+}
@@ -3,3 +3,6 @@
 #include <string>
 
 std::string absolutePath(const std::string&, const std::string&);
+
+// $XDG_RUNTIME_DIR/hypridle-$WAYLAND_DISPLAY.sock, or $HYPRIDLE_SOCKET if set. Empty without either. Shared with hypridlectl.
+std::string controlSocketPath();
@@ -0,0 +1,80 @@
+#include "SdNotify.hpp"
+#include "Log.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <hyprutils/os/FileDescriptor.hpp>
+
+static Hyprutils::OS::CFileDescriptor notifyFd;
+
+struct SEnvironment {
+    std::string               socket;
+    std::chrono::microseconds watchdog{0};
+};
+
+// read once and then taken out of the environment, so that the commands we spawn don't report to systemd in our name
+static const SEnvironment& environment() {
+    static const SEnvironment ENV = []() {
+        SEnvironment env;
+
+        const char* ENVSOCKET = getenv("NOTIFY_SOCKET");
+        const char* ENVUSEC   = getenv("WATCHDOG_USEC");
+        const char* ENVPID    = getenv("WATCHDOG_PID");
+
+        if (ENVSOCKET)
+            env.socket = ENVSOCKET;
+
+        // WATCHDOG_PID is set for another process e.g. when inherited from a wrapper script
+        if (ENVUSEC && *ENVUSEC && (!ENVPID || !*ENVPID || std::strtoll(ENVPID, nullptr, 10) == getpid()))
+            env.watchdog = std::chrono::microseconds{std::strtoll(ENVUSEC, nullptr, 10)};
+
+        unsetenv("NOTIFY_SOCKET");
+        unsetenv("WATCHDOG_USEC");
+        unsetenv("WATCHDOG_PID");
+
+        return env;
+    }();
+
+    return ENV;
+}
+
+bool SdNotify::notify(std::string_view state) {
+    const auto& PATH = environment().socket;
+    if (PATH.empty())
+        return false;
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    // only plain paths and abstract sockets, systemd doesn't hand out anything else for user services
+    if ((PATH[0] != '/' && PATH[0] != '@') || PATH.size() >= sizeof(addr.sun_path)) {
+        Debug::log(ERR, "Unsupported NOTIFY_SOCKET {}", PATH);
+        return false;
+    }
+
+    memcpy(addr.sun_path, PATH.data(), PATH.size());
+    if (PATH[0] == '@')
+        addr.sun_path[0] = '\0';
+
+    // abstract addresses aren't null terminated, their length is all there is
+    const socklen_t LEN = offsetof(sockaddr_un, sun_path) + PATH.size() + (PATH[0] == '/');
+
+    if (!notifyFd.isValid())
+        notifyFd = Hyprutils::OS::CFileDescriptor{socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)};
+
+    if (!notifyFd.isValid() || sendto(notifyFd.get(), state.data(), state.size(), MSG_NOSIGNAL, (sockaddr*)&addr, LEN) < 0) {
+        Debug::log(ERR, "sd_notify {} failed: {}", state, strerror(errno));
+        return false;
+    }
+
+    Debug::log(TRACE, "sd_notify {}", state);
+    return true;
+}
+
+std::chrono::microseconds SdNotify::watchdogInterval() {
+    return environment().watchdog;
+}
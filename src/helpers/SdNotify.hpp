@@ -0,0 +1,14 @@
+#pragma once
+
+#include <chrono>
+#include <string_view>
+
+// The sd_notify protocol, spoken directly over $NOTIFY_SOCKET so that we don't need libsystemd.
+// NOTIFY_SOCKET, WATCHDOG_USEC and WATCHDOG_PID are read on first use and unset, the commands we run shouldn't see them.
+namespace SdNotify {
+    // false if we weren't started with Type=notify (or the message couldn't be sent)
+    bool                      notify(std::string_view state);
+
+    // $WATCHDOG_USEC if the watchdog is meant for us, 0 otherwise. WATCHDOG=1 has to be sent at least that often.
+    std::chrono::microseconds watchdogInterval();
+};
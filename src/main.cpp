@@ -1,11 +1,31 @@
 
 #include "config/ConfigManager.hpp"
+#include "config/ConfigWatcher.hpp"
 #include "core/Hypridle.hpp"
+#include "core/EventLoop.hpp"
+#include "core/Executor.hpp"
+#include "core/Backlight.hpp"
+#include "core/HyprlandIPC.hpp"
+#include "core/Metrics.hpp"
+#include "core/Tracer.hpp"
+#include "core/EventRecorder.hpp"
+#include "core/ControlSocket.hpp"
 #include "helpers/Log.hpp"
+#include <chrono>
+#include <cstdlib>
 #include <memory>
 
 int main(int argc, char** argv, char** envp) {
+    const auto STARTED = std::chrono::steady_clock::now();
+
     std::string configPath;
+    std::string recordPath;
+    std::string replayPath;
+    double      replaySpeed    = 1.0;
+    bool        startupProfile = false;
+
+    Debug::installCrashHandler();
+    std::atexit([]() { Debug::flush(); });
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -16,6 +36,49 @@ int main(int argc, char** argv, char** envp) {
         else if (arg == "--quiet" || arg == "-q")
             Debug::quiet = true;
 
+        else if (arg == "--no-flight-recorder")
+            Debug::flightRecorder = false;
+
+        else if (arg == "--journal") {
+            if (!Debug::enableJournal())
+                Debug::log(WARN, "Couldn't connect to journald, logging to stdout");
+        }
+
+        else if (arg == "--startup-profile")
+            startupProfile = true;
+
+        else if (arg == "--trace") {
+            if (i + 1 >= argc || argv[i + 1][0] == '-') {
+                Debug::log(NONE, "After {} you should provide a path to write the trace to.", arg);
+                return 1;
+            }
+
+            g_pTracer = std::make_unique<CTracer>(argv[++i]);
+        }
+
+        else if (arg == "--record" || arg == "--replay") {
+            if (i + 1 >= argc || argv[i + 1][0] == '-') {
+                Debug::log(NONE, "After {} you should provide a path to a recording.", arg);
+                return 1;
+            }
+
+            (arg == "--record" ? recordPath : replayPath) = argv[++i];
+        }
+
+        else if (arg == "--replay-speed") {
+            if (i + 1 >= argc) {
+                Debug::log(NONE, "After {} you should provide a speed factor.", arg);
+                return 1;
+            }
+
+            try {
+                replaySpeed = std::stod(argv[++i]);
+            } catch (...) {
+                Debug::log(NONE, "Invalid replay speed {}", argv[i]);
+                return 1;
+            }
+        }
+
         else if (arg == "--version" || arg == "-V") {
             Debug::log(NONE, "hypridle v{}", HYPRIDLE_VERSION);
             return 0;
@@ -23,7 +86,7 @@ int main(int argc, char** argv, char** envp) {
 
         else if (arg == "--config" || arg == "-c") {
             if (i + 1 >= argc) {
-                Debug::log(NONE, "After " + arg + " you should provide a path to a config file.");
+                Debug::log(NONE, "After {} you should provide a path to a config file.", arg);
                 return 1;
             }
 
@@ -34,7 +97,7 @@ int main(int argc, char** argv, char** envp) {
 
             configPath = argv[++i];
             if (configPath[0] == '-') { // Should be fine, because of the null terminator
-                Debug::log(NONE, "After " + arg + " you should provide a path to a config file.");
+                Debug::log(NONE, "After {} you should provide a path to a config file.", arg);
                 return 1;
             }
         }
@@ -47,6 +110,13 @@ int main(int argc, char** argv, char** envp) {
                        "  -q, --quiet         Suppress all output except errors\n"
                        "  -V, --version       Show version information\n"
                        "  -c, --config <path> Specify a custom config file path\n"
+                       "      --journal       Log to journald directly\n"
+                       "      --no-flight-recorder Don't keep the last log lines (TRACE included) for crash dumps\n"
+                       "      --startup-profile Print how long each startup phase took\n"
+                       "      --trace <path>  Record a Chrome/Perfetto trace, written on exit and on SIGUSR1\n"
+                       "      --record <path> Record idle, lock, inhibit and sleep events\n"
+                       "      --replay <path> Replay a recording without a compositor or bus, reporting commands instead of running them\n"
+                       "      --replay-speed <factor> Speed up (or slow down) the replay, 0 replays as fast as possible\n"
                        "  -h, --help          Show this help message");
             return 0;
         }
@@ -68,8 +138,39 @@ int main(int argc, char** argv, char** envp) {
 
     g_pConfigManager->init();
 
+    g_pMetrics   = std::make_unique<CMetrics>();
+    g_pEventLoop = std::make_unique<CEventLoop>();
+    g_pExecutor  = std::make_unique<CExecutor>();
+    g_pBacklight = std::make_unique<CBacklight>();
+
+    g_pHyprlandIPC = std::make_unique<CHyprlandIPC>();
+
+    g_pConfigWatcher = std::make_unique<CConfigWatcher>();
+
     g_pHypridle = std::make_unique<CHypridle>();
+
+    if (!replayPath.empty()) {
+        const int RET = g_pHypridle->replay(replayPath, replaySpeed);
+        Debug::flush();
+        return RET;
+    }
+
+    if (!recordPath.empty()) {
+        g_pEventRecorder = std::make_unique<CEventRecorder>(recordPath);
+        if (!g_pEventRecorder->good())
+            return 1;
+    }
+
+    g_pControlSocket = std::make_unique<CControlSocket>();
+
+    if (startupProfile)
+        g_pHypridle->enableStartupProfile(STARTED);
+
     g_pHypridle->run();
 
+    g_pControlSocket.reset();
+    g_pEventRecorder.reset();
+
+    Debug::flush();
     return 0;
 }
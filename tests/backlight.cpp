@@ -0,0 +1,67 @@
+#include "shared.hpp"
+#include "../src/core/Backlight.hpp"
+
+static std::string brightnessOf(const std::string& device) {
+    const auto VALUE = readFile(tempDir() + "/sys/class/" + device + "/brightness");
+    return VALUE.substr(0, VALUE.find('\n'));
+}
+
+int main(int argc, char** argv) {
+    int ret = 0;
+
+    writeFile(tempDir() + "/sys/class/backlight/intel_backlight/brightness", "800\n");
+    writeFile(tempDir() + "/sys/class/backlight/intel_backlight/max_brightness", "1000\n");
+    writeFile(tempDir() + "/sys/class/leds/input0::kbd_backlight/brightness", "3\n");
+    writeFile(tempDir() + "/sys/class/leds/input0::kbd_backlight/max_brightness", "3\n");
+
+    loadConfig("    sysfs_root = " + tempDir() + "/sys\n    backlight_fade_ms = 0");
+    g_pBacklight = std::make_unique<CBacklight>();
+
+    size_t     done = 0;
+    const auto RUN  = [&done](const std::string& command) {
+        const auto ACTION = CConfigManager::parseAction(command);
+        if (!ACTION) {
+            std::cout << "Bad action " << command << ": " << ACTION.error() << "\n";
+            std::exit(1);
+        }
+
+        g_pBacklight->run(*ACTION, [&done]() { done++; });
+    };
+
+    // without a device, the first backlight
+    RUN("backlight:dim 50%");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "500");
+
+    // dimming never brightens
+    RUN("backlight:dim 90%");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "500");
+
+    // back to what it was before the first dim
+    RUN("backlight:restore");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "800");
+
+    // a shorter value than the one before
+    RUN("backlight:set 30");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "30");
+
+    RUN("backlight:set 2000");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "1000");
+
+    // leds by glob, nothing saved for it yet
+    RUN("backlight:restore *kbd_backlight");
+    EXPECT(brightnessOf("leds/input0::kbd_backlight"), "3");
+
+    RUN("backlight:dim 50% *kbd_backlight");
+    EXPECT(brightnessOf("leds/input0::kbd_backlight"), "1");
+    EXPECT(brightnessOf("backlight/intel_backlight"), "1000");
+
+    RUN("backlight:restore *kbd_backlight");
+    EXPECT(brightnessOf("leds/input0::kbd_backlight"), "3");
+
+    // still calls done, the action graph waits on it
+    RUN("backlight:set 10 nonexistent");
+
+    EXPECT(done, 9);
+
+    return ret;
+}
@@ -0,0 +1,71 @@
+#include "shared.hpp"
+
+using SAction = CConfigManager::SAction;
+
+// eType is a uint8_t, it would print as a char
+constexpr int COMMAND   = SAction::ACTION_COMMAND;
+constexpr int BACKLIGHT = SAction::ACTION_BACKLIGHT;
+constexpr int LOGIND    = SAction::ACTION_LOGIND;
+constexpr int HYPRCTL   = SAction::ACTION_HYPRCTL;
+constexpr int INVALID   = -1;
+
+static int typeOf(const std::string& command) {
+    const auto ACTION = CConfigManager::parseAction(command);
+    return ACTION ? ACTION->type : INVALID;
+}
+
+static std::string verbOf(const std::string& command) {
+    const auto ACTION = CConfigManager::parseAction(command);
+    return ACTION ? ACTION->verb : "(error)";
+}
+
+static int argsOf(const std::string& command) {
+    const auto ACTION = CConfigManager::parseAction(command);
+    return ACTION ? (int)ACTION->args.size() : 0;
+}
+
+int main(int argc, char** argv) {
+    int ret = 0;
+
+    // plain commands, colons included
+    EXPECT(typeOf("loginctl lock-session"), COMMAND);
+    EXPECT(typeOf("notify-send hello:world"), COMMAND);
+    EXPECT(typeOf("foo:bar"), COMMAND);
+    EXPECT(typeOf(""), COMMAND);
+
+    // backlight:
+    EXPECT(typeOf("backlight:dim 10%"), BACKLIGHT);
+    EXPECT(verbOf("backlight:dim 10%"), "dim");
+    EXPECT(argsOf("backlight:dim 10% intel_backlight"), 2);
+    EXPECT(typeOf("backlight:set 120"), BACKLIGHT);
+    EXPECT(typeOf("backlight:restore"), BACKLIGHT);
+    EXPECT(typeOf("backlight:restore *::kbd_backlight"), BACKLIGHT);
+    EXPECT(typeOf("backlight:dim"), INVALID);
+    EXPECT(typeOf("backlight:dim 101%"), INVALID);
+    EXPECT(typeOf("backlight:dim -5"), INVALID);
+    EXPECT(typeOf("backlight:dim ten"), INVALID);
+    EXPECT(typeOf("backlight:dim 10 a b"), INVALID);
+    EXPECT(typeOf("backlight:restore a b"), INVALID);
+    EXPECT(typeOf("backlight:blink"), INVALID);
+    EXPECT(typeOf("backlight:"), INVALID);
+
+    // logind:
+    EXPECT(typeOf("logind:lock-session"), LOGIND);
+    EXPECT(typeOf("logind:suspend-then-hibernate"), LOGIND);
+    EXPECT(typeOf("logind:set-idle-hint true"), LOGIND);
+    EXPECT(argsOf("logind:set-idle-hint false"), 1);
+    EXPECT(typeOf("logind:set-idle-hint yes"), INVALID);
+    EXPECT(typeOf("logind:set-idle-hint"), INVALID);
+    EXPECT(typeOf("logind:suspend now"), INVALID);
+    EXPECT(typeOf("logind:reboot"), INVALID);
+
+    // hyprctl:
+    EXPECT(typeOf("hyprctl:dispatch dpms off"), HYPRCTL);
+    EXPECT(verbOf("hyprctl:dispatch dpms off"), "dispatch");
+    EXPECT(argsOf("hyprctl:dispatch   dpms\toff"), 2);
+    EXPECT(typeOf("hyprctl:keyword misc:vfr 0"), HYPRCTL);
+    EXPECT(typeOf("hyprctl:dispatch dpms off; dispatch exit"), INVALID);
+    EXPECT(typeOf("hyprctl:"), INVALID);
+
+    return ret;
+}
@@ -0,0 +1,129 @@
+#include "shared.hpp"
+#include "../src/core/EventLoop.hpp"
+#include "../src/core/HyprlandIPC.hpp"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+// stands in for Hyprland's request socket on the same loop: records what it got, answers "ok" per request and hangs up
+static std::vector<std::string> received;
+
+static void onClient(int fd) {
+    char          buf[1024];
+    const ssize_t LEN = read(fd, buf, sizeof(buf));
+    g_pEventLoop->removeFd(fd);
+
+    if (LEN > 0) {
+        const std::string MESSAGE{buf, (size_t)LEN};
+        received.push_back(MESSAGE);
+
+        const std::string REPLY = MESSAGE.starts_with("[[BATCH]]") ? "ok\n\nok\n\n" : "ok";
+        if (write(fd, REPLY.data(), REPLY.size()) < 0)
+            std::cout << "Couldn't reply: " << strerror(errno) << "\n";
+    }
+
+    close(fd);
+}
+
+int main(int argc, char** argv) {
+    int        ret  = 0;
+
+    const auto PATH = tempDir() + "/hyprland.sock";
+    loadConfig("    hyprland_socket = " + PATH);
+
+    g_pEventLoop   = std::make_unique<CEventLoop>();
+    g_pHyprlandIPC = std::make_unique<CHyprlandIPC>();
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, PATH.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int LISTENFD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (LISTENFD < 0 || bind(LISTENFD, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(LISTENFD, 4) < 0) {
+        std::cout << "Couldn't listen on " << PATH << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    g_pEventLoop->addFd(LISTENFD, EPOLLIN, [LISTENFD](uint32_t) {
+        const int FD = accept4(LISTENFD, nullptr, nullptr, SOCK_CLOEXEC);
+        if (FD >= 0)
+            g_pEventLoop->addFd(FD, EPOLLIN, [FD](uint32_t) { onClient(FD); });
+    });
+
+    // in case a reply never makes it back
+    g_pEventLoop->addTimer(std::chrono::seconds{5}, []() {
+        std::cout << "Timed out\n";
+        g_pEventLoop->terminate();
+    });
+
+    const auto RUN = [](const std::string& command, std::function<void()> done) {
+        const auto ACTION = CConfigManager::parseAction(command);
+        if (!ACTION) {
+            std::cout << "Bad action " << command << ": " << ACTION.error() << "\n";
+            std::exit(1);
+        }
+
+        g_pHyprlandIPC->run(*ACTION, std::move(done));
+    };
+
+    size_t     batchDone = 0, singleDone = 0, failedDone = 0;
+
+    // nobody listening anymore, done is still called
+    const auto FAILED = [&]() {
+        failedDone++;
+        g_pEventLoop->terminate();
+    };
+
+    // a request on its own goes out verbatim
+    const auto SINGLE = [&]() {
+        singleDone++;
+        unlink(PATH.c_str());
+        RUN("hyprctl:dispatch dpms on", FAILED);
+    };
+
+    // both are queued before the loop runs, so they go out as one batch
+    const auto BATCHED = [&]() {
+        if (++batchDone == 2)
+            RUN("hyprctl:keyword general:border_size 2", SINGLE);
+    };
+
+    RUN("hyprctl:dispatch dpms off", BATCHED);
+    RUN("hyprctl:keyword decoration:rounding 0", BATCHED);
+
+    g_pEventLoop->enter();
+
+    EXPECT(received.size(), 2);
+    if (received.size() == 2) {
+        EXPECT(received[0], "[[BATCH]]dispatch dpms off;keyword decoration:rounding 0;");
+        EXPECT(received[1], "keyword general:border_size 2");
+    }
+
+    EXPECT(batchDone, 2);
+    EXPECT(singleDone, 1);
+    EXPECT(failedDone, 1);
+
+    close(LISTENFD);
+
+    // after a restart on the same display: the old instance's directory is left behind, another instance runs on another display
+    const auto RUNTIME = tempDir() + "/runtime";
+    writeFile(RUNTIME + "/hypr/dead/hyprland.lock", "2147483647\nwayland-1\n");
+    writeFile(RUNTIME + "/hypr/nested/hyprland.lock", std::to_string(getpid()) + "\nwayland-2\n");
+    writeFile(RUNTIME + "/hypr/restarted/hyprland.lock", std::to_string(getpid()) + "\nwayland-1\n");
+
+    setenv("XDG_RUNTIME_DIR", RUNTIME.c_str(), 1);
+    setenv("WAYLAND_DISPLAY", "wayland-1", 1);
+    setenv("HYPRLAND_INSTANCE_SIGNATURE", "dead", 1);
+
+    g_pHyprlandIPC->followInstance();
+    EXPECT(std::string{getenv("HYPRLAND_INSTANCE_SIGNATURE")}, "restarted");
+
+    // nothing on our display, the signature is left alone
+    setenv("WAYLAND_DISPLAY", "wayland-3", 1);
+    g_pHyprlandIPC->followInstance();
+    EXPECT(std::string{getenv("HYPRLAND_INSTANCE_SIGNATURE")}, "restarted");
+
+    return ret;
+}
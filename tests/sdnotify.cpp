@@ -0,0 +1,53 @@
+#include "shared.hpp"
+#include "../src/helpers/SdNotify.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+
+// what systemd would get, empty if nothing arrived
+static std::string receive(int fd) {
+    char          buf[256];
+    const ssize_t LEN = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    return LEN > 0 ? std::string{buf, (size_t)LEN} : std::string{};
+}
+
+int main(int argc, char** argv) {
+    int         ret  = 0;
+
+    const auto  PATH = tempDir() + "/notify.sock";
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, PATH.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int FD = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (FD < 0 || bind(FD, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cout << "Couldn't bind " << PATH << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    setenv("NOTIFY_SOCKET", PATH.c_str(), 1);
+    setenv("WATCHDOG_USEC", "20000000", 1);
+    setenv("WATCHDOG_PID", std::to_string(getpid()).c_str(), 1);
+
+    EXPECT(SdNotify::watchdogInterval().count(), 20000000);
+
+    // gone from the environment, but still known to us
+    EXPECT(getenv("NOTIFY_SOCKET") == nullptr, true);
+    EXPECT(getenv("WATCHDOG_USEC") == nullptr, true);
+    EXPECT(getenv("WATCHDOG_PID") == nullptr, true);
+
+    EXPECT(SdNotify::notify("READY=1\nSTATUS=1 listeners armed"), true);
+    EXPECT(receive(FD), "READY=1\nSTATUS=1 listeners armed");
+
+    EXPECT(SdNotify::notify("WATCHDOG=1"), true);
+    EXPECT(receive(FD), "WATCHDOG=1");
+
+    // setting it again doesn't redirect us, it was only read once
+    setenv("NOTIFY_SOCKET", "/nonexistent", 1);
+    EXPECT(SdNotify::notify("STOPPING=1"), true);
+    EXPECT(receive(FD), "STOPPING=1");
+
+    close(FD);
+    return ret;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../src/config/ConfigManager.hpp"
+
+namespace Colors {
+    constexpr const char* RED   = "\x1b[31m";
+    constexpr const char* GREEN = "\x1b[32m";
+    constexpr const char* RESET = "\x1b[0m";
+};
+
+#define EXPECT(expr, val)                                                                                                                                                          \
+    if (const auto RESULT = expr; RESULT != (val)) {                                                                                                                               \
+        std::cout << Colors::RED << "Failed: " << Colors::RESET << #expr << ", expected " << val << " but got " << RESULT << "\n";                                                 \
+        ret = 1;                                                                                                                                                                   \
+    } else {                                                                                                                                                                       \
+        std::cout << Colors::GREEN << "Passed " << Colors::RESET << #expr << ". Got " << val << "\n";                                                                              \
+    }
+
+// removed again when the test exits
+inline std::string tempDir() {
+    static std::string dir = []() {
+        char templ[] = "/tmp/hypridle-test-XXXXXX";
+        if (!mkdtemp(templ)) {
+            std::cerr << "Couldn't create a temporary directory\n";
+            std::exit(1);
+        }
+
+        std::atexit([]() {
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+        });
+
+        return std::string{templ};
+    }();
+
+    return dir;
+}
+
+inline void writeFile(const std::string& path, const std::string& contents) {
+    std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+    std::ofstream(path) << contents;
+}
+
+inline std::string readFile(const std::string& path) {
+    std::ifstream ifs(path);
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+}
+
+// g_pConfigManager with a listener and whatever general: values the test needs. Values are read once, like in the daemon.
+inline void loadConfig(const std::string& general) {
+    const auto PATH = tempDir() + "/hypridle.conf";
+    writeFile(PATH, "general {\n" + general + "\n}\n\nlistener {\n    timeout = 300\n}\n");
+
+    g_pConfigManager = std::make_unique<CConfigManager>(PATH);
+    g_pConfigManager->init();
+}